@@ -38,9 +38,9 @@ void RingnetTcpWriterClient::onConnected()
 		std::terminate();
 	});
 
-	connection->onWrite([this](ringnet::events::WriteEvent &&) {
-		written_bytes += packet.size();
-		remaining_bytes_before_print -= packet.size();
+	connection->onWrite([this](ringnet::events::WriteEvent &&event) {
+		written_bytes += event.bytes_written.size();
+		remaining_bytes_before_print -= event.bytes_written.size();
 		if (remaining_bytes_before_print <= 0) {
 			std::cout << "TcpWriter: Written " << written_bytes << " bytes" << std::endl;
 			remaining_bytes_before_print = BYTES_PRINT_INTERVAL;
@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <coroutine>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+
+#include <doctest.h>
+
+#include "ringnet/coro/task.hpp"
+#include "ringnet/net/acceptor.hpp"
+#include "ringnet/net/connection.hpp"
+#include "ringnet/net/connector.hpp"
+
+using namespace ringnet;
+
+namespace
+{
+std::string to_string(std::span<const std::byte> data)
+{
+	return std::string(reinterpret_cast<const char *>(data.data()), data.size());
+}
+
+/// @brief Write back each read message, until the peer disconnects.
+coro::Task<void> echo(net::Connection connection)
+{
+	while (true) {
+		auto read = co_await connection.read();
+		if (!read || read->bytes_read.empty())
+			co_return;
+
+		// The read bytes are only valid until the next suspension.
+		std::vector<std::byte> echoed(read->bytes_read.begin(), read->bytes_read.end());
+		auto written = co_await connection.write(echoed);
+		if (!written)
+			co_return;
+	}
+}
+} // namespace
+
+TEST_CASE("TCP echo with coroutines")
+{
+	static constexpr uint16_t PORT = 4249;
+	static constexpr size_t CLIENTS_COUNT = 3;
+
+	EventLoop loop(1024);
+	auto acceptor = loop.resource<net::Acceptor<net::TCP>>();
+	REQUIRE(acceptor.listen("127.0.0.1", PORT));
+
+	auto serve = [&]() -> coro::Task<void> {
+		for (size_t accepted = 0; accepted < CLIENTS_COUNT; accepted++) {
+			auto connection = co_await acceptor.next();
+			CHECK(connection.has_value());
+			if (connection)
+				loop.spawn(echo(std::move(connection.value())));
+		}
+	};
+
+	std::vector<std::string> received{};
+	size_t done_count = 0;
+	auto request = [&](std::string message) -> coro::Task<void> {
+		// Created by the loop: the frame comes from its pool.
+		CHECK(coro::FramePool::current() != nullptr);
+
+		net::Connector<net::TCP> connector{ loop };
+		auto connection = co_await connector.connect("127.0.0.1", PORT);
+		REQUIRE(connection.has_value());
+
+		auto written = co_await connection->write(std::as_bytes(std::span{ message }));
+		CHECK(written.has_value());
+
+		std::array<std::byte, 64> reception_buffer{};
+		auto read = co_await connection->read(reception_buffer);
+		REQUIRE(read.has_value());
+		received.push_back(to_string(read->bytes_read));
+
+		if (++done_count == CLIENTS_COUNT)
+			loop.stop();
+	};
+
+	loop.spawn(serve);
+	for (size_t client = 0; client < CLIENTS_COUNT; client++)
+		loop.spawn([&, client]() { return request("Hello #" + std::to_string(client)); });
+	CHECK(coro::FramePool::current() == nullptr);
+
+	loop.run();
+
+	REQUIRE(received.size() == CLIENTS_COUNT);
+	std::sort(received.begin(), received.end());
+	for (size_t client = 0; client < CLIENTS_COUNT; client++)
+		CHECK(received[client] == "Hello #" + std::to_string(client));
+}
+
+TEST_CASE("Coroutine destroyed while awaiting a read")
+{
+	EventLoop loop(64);
+	std::array<int, 2> sockets{};
+	REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets.data()) == 0);
+	net::FileDescriptor peer(sockets[1]);
+
+	bool resumed = false;
+	auto read_once = [&resumed](net::Connection connection) -> coro::Task<void> {
+		co_await connection.read();
+		resumed = true;
+	};
+
+	{
+		coro::Task<void> reading = read_once(net::Connection(loop, net::FileDescriptor(sockets[0])));
+		// Started as if awaited, up to its suspension on the read.
+		reading.operator co_await().await_suspend(std::noop_coroutine()).resume();
+	}
+	// The read was detached along with the frame: its cancellation, by the connection closing, is ignored.
+	time::Timer stop([&loop]() { loop.stop(); });
+	loop.post([&]() { loop.schedule(stop, std::chrono::milliseconds(20)); });
+	loop.run();
+	CHECK_FALSE(resumed);
+}
@@ -0,0 +1,240 @@
+#include <array>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <doctest.h>
+
+#include "ringnet/eventLoop.hpp"
+
+using namespace ringnet;
+using namespace std::chrono_literals;
+
+/// @brief Run the loop on the calling thread, and stop it from another thread after the given duration.
+inline void runFor(EventLoop &loop, std::chrono::milliseconds duration)
+{
+	std::thread stopper([&loop, duration]() {
+		std::this_thread::sleep_for(duration);
+		loop.stop();
+	});
+	loop.run();
+	stopper.join();
+}
+
+TEST_CASE("Idle strategies")
+{
+	EventLoop loop(64);
+
+	SUBCASE("Blocking loop sleeps in the kernel")
+	{
+		loop.setIdleStrategy(IdleStrategy::block(10ms));
+		runFor(loop, 100ms);
+
+		CHECK(loop.statistics().iterations <= 20);
+		CHECK(loop.statistics().idle_time >= 50ms);
+	}
+
+	SUBCASE("Spinning loop eventually sleeps in the kernel")
+	{
+		loop.setIdleStrategy(IdleStrategy::spinThenBlock(1ms, 10ms));
+		runFor(loop, 100ms);
+
+		CHECK(loop.statistics().iterations <= 20);
+		CHECK(loop.statistics().idle_time >= 50ms);
+	}
+
+	SUBCASE("Busy polling loop never sleeps")
+	{
+		loop.setIdleStrategy(IdleStrategy::busyPoll(10us));
+		runFor(loop, 100ms);
+
+		CHECK(loop.statistics().iterations >= 1000);
+		CHECK(loop.statistics().idle_time >= 50ms);
+	}
+}
+
+TEST_CASE("Posted tasks wake the loop up")
+{
+	// Long enough for the test to time out if posted tasks waited for the loop to wake up on its own.
+	constexpr auto IDLE_TIMEOUT = 5s;
+	constexpr auto MAX_WAKEUP_DELAY = 1s;
+
+	SUBCASE("Posted from another thread")
+	{
+		EventLoop loop(64);
+		loop.setIdleStrategy(IdleStrategy::block(IDLE_TIMEOUT));
+		std::thread loop_thread([&loop]() { loop.run(); });
+
+		// Let the loop go idle.
+		std::this_thread::sleep_for(10ms);
+
+		constexpr int TASKS_COUNT = 100;
+		int counter = 0;
+		std::promise<std::pair<int, std::thread::id>> done{};
+		for (int task = 0; task < TASKS_COUNT; task++)
+			loop.post([&counter]() { ++counter; });
+		loop.post([&counter, &done]() { done.set_value({ counter, std::this_thread::get_id() }); });
+
+		auto result = done.get_future();
+		REQUIRE(result.wait_for(MAX_WAKEUP_DELAY) == std::future_status::ready);
+		const auto [ran_count, thread_id] = result.get();
+		CHECK(ran_count == TASKS_COUNT);
+		CHECK(thread_id == loop_thread.get_id());
+
+		const auto stop_time = std::chrono::steady_clock::now();
+		loop.stop();
+		loop_thread.join();
+		CHECK(std::chrono::steady_clock::now() - stop_time < MAX_WAKEUP_DELAY);
+	}
+
+	SUBCASE("Posted from another loop")
+	{
+		EventLoop source(64);
+		EventLoop target(64);
+		source.setIdleStrategy(IdleStrategy::block(IDLE_TIMEOUT));
+		target.setIdleStrategy(IdleStrategy::block(IDLE_TIMEOUT));
+		std::thread source_thread([&source]() { source.run(); });
+		std::thread target_thread([&target]() { target.run(); });
+
+		std::this_thread::sleep_for(10ms);
+
+		std::promise<std::thread::id> done{};
+		source.post([&]() {
+			source.postTo(target, [&done]() { done.set_value(std::this_thread::get_id()); });
+		});
+
+		auto result = done.get_future();
+		REQUIRE(result.wait_for(MAX_WAKEUP_DELAY) == std::future_status::ready);
+		CHECK(result.get() == target_thread.get_id());
+
+		source.stop();
+		target.stop();
+		source_thread.join();
+		target_thread.join();
+	}
+}
+
+TEST_CASE("Completion budget bounds the completions handled per iteration")
+{
+	constexpr int READS_COUNT = 8;
+
+	EventLoop loop(64);
+	loop.setCompletionBudget(1);
+
+	int pipe_fds[2];
+	REQUIRE(::pipe(pipe_fds) == 0);
+	const std::array<char, READS_COUNT> message{};
+	REQUIRE(::write(pipe_fds[1], message.data(), message.size()) == READS_COUNT);
+
+	// All reads complete right away, within the same submission.
+	std::array<std::byte, READS_COUNT> reception_buffer{};
+	std::vector<uint64_t> iterations{};
+	Subscriber subscriber{};
+	subscriber.on<events::ReadEvent>([&](events::ReadEvent &&) {
+		iterations.push_back(loop.statistics().iterations);
+		if (iterations.size() == READS_COUNT)
+			loop.stop();
+	});
+	for (int read = 0; read < READS_COUNT; read++) {
+		const auto byte = std::span{ &reception_buffer[read], 1 };
+		loop.add(uring::ReadRequest{ .fd = pipe_fds[0], .reception_buffer = byte }, &subscriber);
+	}
+
+	loop.run();
+	::close(pipe_fds[0]);
+	::close(pipe_fds[1]);
+
+	REQUIRE(iterations.size() == READS_COUNT);
+	for (int read = 1; read < READS_COUNT; read++)
+		CHECK(iterations[read] > iterations[read - 1]);
+	CHECK(loop.statistics().completions >= READS_COUNT);
+}
+
+TEST_CASE("Requests are either refused or completed, never lost")
+{
+	// Submission queue of 4 entries: request slots are bounded by the completion queue size (8).
+	constexpr int QUEUE_SIZE = 4;
+	constexpr int ATTEMPTS_COUNT = 16;
+
+	EventLoop loop(QUEUE_SIZE);
+
+	int pipe_fds[2];
+	REQUIRE(::pipe(pipe_fds) == 0);
+	const std::array<char, ATTEMPTS_COUNT> message{};
+	REQUIRE(::write(pipe_fds[1], message.data(), message.size()) == ATTEMPTS_COUNT);
+
+	std::array<std::byte, ATTEMPTS_COUNT> reception_buffer{};
+	int accepted_count = 0;
+	int completed_count = 0;
+	Subscriber subscriber{};
+	subscriber.on<events::ReadEvent>([&](events::ReadEvent &&) {
+		if (++completed_count == accepted_count)
+			loop.stop();
+	});
+	for (int read = 0; read < ATTEMPTS_COUNT; read++) {
+		const auto byte = std::span{ &reception_buffer[read], 1 };
+		uring::ReadRequest request{ .fd = pipe_fds[0], .reception_buffer = byte };
+		if (loop.add(std::move(request), &subscriber) == uring::OK)
+			++accepted_count;
+	}
+	// More requests than submission entries are accepted, but not more than request slots.
+	CHECK(accepted_count > QUEUE_SIZE);
+	CHECK(accepted_count < ATTEMPTS_COUNT);
+
+	loop.run();
+	::close(pipe_fds[0]);
+	::close(pipe_fds[1]);
+
+	CHECK(completed_count == accepted_count);
+}
+
+TEST_CASE("Batching policy")
+{
+	constexpr auto MAX_DELAY = 100ms;
+	constexpr size_t BATCH_SIZE = 16;
+
+	EventLoop loop(64);
+	loop.setBatchingPolicy(BatchingPolicy::batch(BATCH_SIZE, MAX_DELAY));
+
+	int pipe_fds[2];
+	REQUIRE(::pipe(pipe_fds) == 0);
+	const char message = 'A';
+	REQUIRE(::write(pipe_fds[1], &message, 1) == 1);
+
+	std::byte reception_byte{};
+	std::chrono::steady_clock::time_point added_time{};
+	std::chrono::nanoseconds read_delay{};
+	Subscriber subscriber{};
+	subscriber.on<events::ReadEvent>([&](events::ReadEvent &&) {
+		read_delay = std::chrono::steady_clock::now() - added_time;
+		loop.stop();
+	});
+	uring::ReadRequest request{ .fd = pipe_fds[0], .reception_buffer = std::span{ &reception_byte, 1 } };
+
+	// Added once the loop runs, apart from the internal (urgent) requests added on construction.
+	time::Timer add_read{ [&]() {
+		added_time = std::chrono::steady_clock::now();
+		REQUIRE(loop.add(std::move(request), &subscriber) == uring::OK);
+	} };
+	loop.schedule(add_read, 1ms);
+
+	SUBCASE("Incomplete batches are submitted once the delay expired")
+	{
+		loop.run();
+		CHECK(read_delay >= MAX_DELAY / 2);
+	}
+
+	SUBCASE("Urgent requests are submitted right away")
+	{
+		request.header.flags = uring::URGENT;
+		loop.run();
+		CHECK(read_delay < MAX_DELAY / 2);
+	}
+
+	::close(pipe_fds[0]);
+	::close(pipe_fds[1]);
+	CHECK(loop.statistics().submissions >= 1);
+	CHECK(loop.statistics().averageBatchSize() >= 1.);
+}
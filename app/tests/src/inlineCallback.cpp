@@ -0,0 +1,54 @@
+#include <memory>
+
+#include <doctest.h>
+
+#include "ringnet/eventHandler.hpp"
+#include "ringnet/inlineCallback.hpp"
+
+using namespace ringnet;
+
+TEST_CASE("Inline callbacks")
+{
+	SUBCASE("Stores move-only callables in place")
+	{
+		auto value = std::make_unique<int>(42);
+		InlineCallback<int(int)> callback{ [value = std::move(value)](int offset) { return *value + offset; } };
+		REQUIRE(callback);
+		CHECK(callback(1) == 43);
+
+		InlineCallback<int(int)> moved{ std::move(callback) };
+		CHECK_FALSE(callback);
+		CHECK(moved(2) == 44);
+	}
+
+	SUBCASE("Replacing a callback destroys the previous callable")
+	{
+		auto captured = std::make_shared<int>(0);
+		InlineCallback<void()> callback{ [captured]() { ++*captured; } };
+		callback();
+		CHECK(captured.use_count() == 2);
+
+		callback = InlineCallback<void()>{ []() {} };
+		CHECK(captured.use_count() == 1);
+		CHECK(*captured == 1);
+	}
+
+	SUBCASE("Event handlers forward events to the callback of their type")
+	{
+		struct First {
+			int value;
+		};
+		struct Second {
+			int value;
+		};
+
+		int first_value = 0;
+		EventHandler<First, Second> handler{};
+		handler.on<First>([&first_value](First &&event) { first_value = event.value; });
+
+		handler.handle(First{ 1 });
+		// No callback for this event type: ignored.
+		handler.handle(Second{ 2 });
+		CHECK(first_value == 1);
+	}
+}
@@ -0,0 +1,118 @@
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <doctest.h>
+
+#include "ringnet/uring/requestInbox.hpp"
+#include "ringnet/uring/requestPool.hpp"
+#include "ringnet/uring/requests.hpp"
+
+using namespace ringnet::uring;
+
+TEST_CASE("Request pool recycles slots, within a fixed capacity")
+{
+	constexpr size_t CAPACITY = 4;
+	RequestPool<ReadRequest, WriteRequest> pool{ CAPACITY };
+
+	WriteRequest *first = pool.allocate<WriteRequest>();
+	pool.deallocate(first);
+	CHECK(pool.allocate<WriteRequest>() == first);
+	CHECK(static_cast<void *>(pool.allocate<ReadRequest>()) != static_cast<void *>(first));
+
+	for (size_t slot = 1; slot < CAPACITY; slot++)
+		CHECK(pool.allocate<WriteRequest>() != nullptr);
+	CHECK(pool.allocate<WriteRequest>() == nullptr);
+
+	// Each type has its own slab.
+	CHECK(pool.allocate<ReadRequest>() != nullptr);
+
+	pool.deallocate(first);
+	CHECK(pool.allocate<WriteRequest>() == first);
+}
+
+TEST_CASE("Completion user data is tagged with the request operation")
+{
+	RequestPool<ReadRequest, WriteRequest> pool{ 1 };
+
+	WriteRequest *request = pool.allocate<WriteRequest>();
+	request->header.flags = NOTIFY_SINK;
+	const UserData user_data{ UserData::of(request->header).value };
+	CHECK(user_data.op() == Operation::WRITE);
+	CHECK(user_data.has(NOTIFY_SINK));
+	CHECK(user_data.request<WriteRequest>() == request);
+
+	const UserData internal{ UserData::of(Operation::LINK_TIMEOUT).value };
+	CHECK(internal.op() == Operation::LINK_TIMEOUT);
+	CHECK(internal.header() == nullptr);
+	pool.deallocate(request);
+}
+
+TEST_CASE("Request inbox preserves order, with concurrent producers")
+{
+	constexpr int PRODUCERS_COUNT = 4;
+	constexpr int REQUESTS_PER_PRODUCER = 20000;
+
+	// Fewer slots than requests: producers wait for the consumer to give some back.
+	RequestPool<ReadRequest, WriteRequest> pool{ 256 };
+	RequestInbox inbox{};
+
+	auto allocate = [&pool]<class Request>(std::type_identity<Request>) {
+		Request *request = pool.allocate<Request>();
+		while (!request) {
+			std::this_thread::yield();
+			request = pool.allocate<Request>();
+		}
+		return request;
+	};
+
+	std::vector<std::thread> producers{};
+	for (int producer = 0; producer < PRODUCERS_COUNT; producer++) {
+		producers.emplace_back([&allocate, &inbox, producer]() {
+			for (int sequence = 0; sequence < REQUESTS_PER_PRODUCER; sequence++) {
+				// Alternate types: the order must hold across request types.
+				if (sequence % 2) {
+					WriteRequest *request = allocate(std::type_identity<WriteRequest>{});
+					*request = WriteRequest{ .fd = producer };
+					request->header.user_data = reinterpret_cast<void *>(uintptr_t(sequence));
+					inbox.push(&RequestSlot<WriteRequest>::from(request)->link);
+				} else {
+					ReadRequest *request = allocate(std::type_identity<ReadRequest>{});
+					*request = ReadRequest{ .fd = producer };
+					request->header.user_data = reinterpret_cast<void *>(uintptr_t(sequence));
+					inbox.push(&RequestSlot<ReadRequest>::from(request)->link);
+				}
+			}
+		});
+	}
+
+	std::vector<int> next_sequence(PRODUCERS_COUNT, 0);
+	int popped = 0;
+	bool ordered = true;
+	while (popped < PRODUCERS_COUNT * REQUESTS_PER_PRODUCER) {
+		SlotLink *link = inbox.pop();
+		if (!link)
+			continue;
+		++popped;
+
+		RequestHeader *header = headerOf(link);
+		const int sequence = static_cast<int>(reinterpret_cast<uintptr_t>(header->user_data));
+		if (header->op == Operation::WRITE) {
+			auto *request = reinterpret_cast<WriteRequest *>(header);
+			ordered &= (next_sequence[request->fd]++ == sequence);
+			pool.deallocate(request);
+		} else {
+			auto *request = reinterpret_cast<ReadRequest *>(header);
+			ordered &= (next_sequence[request->fd]++ == sequence);
+			pool.deallocate(request);
+		}
+	}
+
+	for (auto &producer : producers)
+		producer.join();
+
+	CHECK(ordered);
+	CHECK(inbox.pop() == nullptr);
+	for (int producer = 0; producer < PRODUCERS_COUNT; producer++)
+		CHECK(next_sequence[producer] == REQUESTS_PER_PRODUCER);
+}
@@ -1,11 +1,18 @@
+#include <array>
+#include <atomic>
+#include <climits>
+#include <functional>
+#include <memory>
 #include <span>
 #include <thread>
+#include <vector>
 
 #include <doctest.h>
 
 #include "ringnet/net/acceptor.hpp"
 #include "ringnet/net/connection.hpp"
 #include "ringnet/net/connector.hpp"
+#include "ringnet/shardedEventLoop.hpp"
 
 #include "operators.hpp"
 
@@ -113,3 +120,996 @@ TEST_CASE("TCP single server, single client")
 		loop.run();
 	}
 }
+
+TEST_CASE("TCP sharded server, multiple clients")
+{
+	static constexpr size_t SHARDS_COUNT = 2;
+	static constexpr size_t CLIENTS_COUNT = 8;
+	static constexpr uint16_t PORT = 4243;
+
+	struct Shard {
+		explicit Shard(EventLoop &loop) : acceptor(loop)
+		{
+		}
+		net::Acceptor<net::TCP> acceptor;
+		std::vector<net::Connection> connections{};
+	};
+
+	ShardedEventLoop shards(SHARDS_COUNT, 1024, false);
+	EventLoop client_loop(1024);
+
+	std::atomic_size_t listening_count = 0;
+	std::atomic_size_t accepted_count = 0;
+
+	std::thread server_thread([&]() {
+		shards.run([&](EventLoop &loop, size_t shard_index) {
+			auto shard = std::make_unique<Shard>(loop);
+			shard->acceptor.onError([](events::ErrorEvent &&event) { FAIL(event.what()); });
+			shard->acceptor.onNewConnection([&, shard_ptr = shard.get()](net::Connection &&connection) {
+				shard_ptr->connections.push_back(std::move(connection));
+				if (++accepted_count == CLIENTS_COUNT)
+					client_loop.stop();
+			});
+
+			auto status = shard->acceptor.listen("127.0.0.1", PORT,
+							     net::Acceptor<net::TCP>::ListeningMode::REUSE_PORT);
+			if (!status)
+				std::cerr << "Shard " << shard_index << ": " << status.what() << std::endl;
+			else
+				++listening_count;
+			return shard;
+		});
+	});
+
+	while (listening_count < SHARDS_COUNT)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+	std::vector<std::unique_ptr<net::Connector<net::TCP>>> clients{};
+	std::vector<net::Connection> client_connections{};
+	for (size_t client_index = 0; client_index < CLIENTS_COUNT; client_index++) {
+		auto &client = clients.emplace_back(std::make_unique<net::Connector<net::TCP>>(client_loop));
+		client->onError([](events::ErrorEvent &&event) { FAIL(event.what()); });
+		client->onConnection([&client_connections](net::Connection &&connection) {
+			client_connections.push_back(std::move(connection));
+		});
+		client->asyncConnect("127.0.0.1", PORT);
+	}
+
+	client_loop.run();
+	shards.stop();
+	server_thread.join();
+
+	CHECK(accepted_count == CLIENTS_COUNT);
+}
+
+TEST_CASE("Sharded loop stopped before running")
+{
+	ShardedEventLoop shards(2, 64, false);
+	shards.stop();
+
+	// The stop is not lost: the shards are set up, but their loops are not run.
+	std::atomic_size_t setups_count = 0;
+	shards.run([&](EventLoop &, size_t) { ++setups_count; });
+	CHECK(setups_count == 2);
+}
+
+TEST_CASE("Sharded loop restarted after a stop")
+{
+	ShardedEventLoop shards(2, 64, false);
+	shards.stop();
+	std::atomic_size_t running_count = 0;
+	auto setup = [&](EventLoop &loop, size_t) {
+		loop.post([&]() {
+			if (++running_count == 2)
+				shards.stop();
+		});
+	};
+	shards.run(setup);
+	CHECK(running_count == 0);
+
+	// The loops run again, until a shard stops them all.
+	shards.restart();
+	shards.run(setup);
+	CHECK(running_count == 2);
+}
+
+/// @brief A server, and a client connected to it, both running on the given loop. Each connection is set up by its
+/// hook once established: errors fail the test, unless the hook handles them.
+struct LoopbackPair {
+	using Hook = std::function<void(net::Connection &)>;
+
+	explicit LoopbackPair(EventLoop &loop) : server(loop), client(loop)
+	{
+	}
+	LoopbackPair(const LoopbackPair &) = delete;
+	LoopbackPair &operator=(const LoopbackPair &) = delete;
+
+	/// @brief Listen on the port, then connect the client to it.
+	void connect(uint16_t port)
+	{
+		server.onError([](events::ErrorEvent &&event) { FAIL(event.what()); });
+		server.onNewConnection([this](net::Connection &&connection) {
+			server_connection = std::make_unique<net::Connection>(std::move(connection));
+			server_connection->onError([](events::ErrorEvent &&event) { FAIL(event.what()); });
+			if (on_server_connection)
+				on_server_connection(*server_connection);
+		});
+		REQUIRE(server.listen("127.0.0.1", port));
+
+		client.onError([](events::ErrorEvent &&event) { FAIL(event.what()); });
+		client.onConnection([this](net::Connection &&connection) {
+			client_connection = std::make_unique<net::Connection>(std::move(connection));
+			client_connection->onError([](events::ErrorEvent &&event) { FAIL(event.what()); });
+			if (on_client_connection)
+				on_client_connection(*client_connection);
+		});
+		client.asyncConnect("127.0.0.1", port);
+	}
+
+	net::Acceptor<net::TCP> server;
+	net::Connector<net::TCP> client;
+	Hook on_server_connection{};
+	Hook on_client_connection{};
+	std::unique_ptr<net::Connection> server_connection{};
+	std::unique_ptr<net::Connection> client_connection{};
+};
+
+/// @brief Connect a client to a server, both running on the given loop, and send a single message.
+/// Return once the server received it.
+void exchangeSingleMessage(EventLoop &loop, uint16_t port)
+{
+	LoopbackPair pair(loop);
+	const_bytes_t message = to_bytes("Hello from the client");
+
+	pair.on_server_connection = [&](net::Connection &server_connection) {
+		server_connection.onRead([&](events::ReadEvent &&event) {
+			CHECK((event.bytes_read == message));
+			loop.stop();
+		});
+		server_connection.asyncRead();
+	};
+	pair.on_client_connection = [&](net::Connection &client_connection) {
+		client_connection.asyncWrite(message);
+	};
+	pair.connect(port);
+
+	loop.run();
+}
+
+TEST_CASE("TCP exchange with kernel-side submission polling")
+{
+	uring::RingConfig ring_config{};
+	ring_config.submission_polling.enabled = true;
+	ring_config.submission_polling.idle_timeout = std::chrono::milliseconds(10);
+	EventLoop loop(1024, ring_config);
+
+	exchangeSingleMessage(loop, 4244);
+}
+
+TEST_CASE("TCP exchange with single issuer, deferred task work and registered ring")
+{
+	uring::RingConfig ring_config{};
+	ring_config.single_issuer = true;
+	ring_config.defer_taskrun = true;
+	ring_config.completion_queue_size = 4096;
+	ring_config.register_ring_fd = true;
+	EventLoop loop(1024, ring_config);
+
+	exchangeSingleMessage(loop, 4245);
+}
+
+TEST_CASE("TCP exchange with cooperative task work")
+{
+	uring::RingConfig ring_config{};
+	ring_config.coop_taskrun = true;
+	EventLoop loop(1024, ring_config);
+
+	exchangeSingleMessage(loop, 4246);
+}
+
+TEST_CASE("TCP deadlines")
+{
+	EventLoop loop(1024);
+	// Long enough for the test to time out if deadlines were not enforced by the kernel.
+	loop.setIdleStrategy(IdleStrategy::block(std::chrono::seconds(5)));
+
+	SUBCASE("Read deadline expires when the peer stays silent")
+	{
+		static constexpr uint16_t PORT = 4247;
+		auto server = loop.resource<net::Acceptor<net::TCP>>();
+		auto client = loop.resource<net::Connector<net::TCP>>();
+		std::unique_ptr<net::Connection> server_connection;
+		std::unique_ptr<net::Connection> client_connection;
+		const_bytes_t message = to_bytes("Within the deadline");
+		int read_error = 0;
+
+		server.onError([](events::ErrorEvent &&event) { FAIL(event.what()); });
+		server.onNewConnection([&](net::Connection &&new_connection) {
+			server_connection = std::make_unique<net::Connection>(std::move(new_connection));
+			server_connection->onError([](events::ErrorEvent &&event) { FAIL(event.what()); });
+			// Answer once, then stay silent.
+			server_connection->asyncWrite(message, std::chrono::seconds(1));
+		});
+		REQUIRE(server.listen("127.0.0.1", PORT));
+
+		client.onError([](events::ErrorEvent &&event) { FAIL(event.what()); });
+		client.onConnection([&](net::Connection &&connection) {
+			client_connection = std::make_unique<net::Connection>(std::move(connection));
+			client_connection->onRead([&](events::ReadEvent &&event) {
+				CHECK((event.bytes_read == message));
+				client_connection->asyncRead(std::chrono::milliseconds(50));
+			});
+			client_connection->onError([&](events::ErrorEvent &&event) {
+				read_error = event.error_code;
+				loop.stop();
+			});
+			client_connection->asyncRead(std::chrono::seconds(1));
+		});
+		client.asyncConnect("127.0.0.1", PORT);
+
+		const auto start = std::chrono::steady_clock::now();
+		loop.run();
+		CHECK(read_error == ETIMEDOUT);
+		CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(2));
+	}
+
+	SUBCASE("Connect deadline expires when the peer does not answer")
+	{
+		static constexpr uint16_t PORT = 4248;
+
+		// A listening socket which never accepts: once its (minimal) backlog is full, connection requests are
+		// dropped, as with a blackholed peer.
+		auto address = net::resolve("127.0.0.1", PORT, net::TCP, true);
+		REQUIRE(address.has_value());
+		net::FileDescriptor listening_socket = ::socket(AF_INET, SOCK_STREAM, 0);
+		REQUIRE(net::set_option(listening_socket, SO_REUSEADDR));
+		REQUIRE(net::bind(listening_socket, address.value()));
+		REQUIRE(net::listen(listening_socket, 0));
+		net::FileDescriptor queued_socket = ::socket(AF_INET, SOCK_STREAM, 0);
+		REQUIRE(net::connect(queued_socket, address.value()));
+
+		auto client = loop.resource<net::Connector<net::TCP>>();
+		int connect_error = 0;
+		client.onConnection([](net::Connection &&) { FAIL("Unexpected connection"); });
+		client.onError([&](events::ErrorEvent &&event) {
+			connect_error = event.error_code;
+			loop.stop();
+		});
+		REQUIRE(client.asyncConnect("127.0.0.1", PORT, std::chrono::milliseconds(50)));
+
+		const auto start = std::chrono::steady_clock::now();
+		loop.run();
+		CHECK(connect_error == ETIMEDOUT);
+		CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(2));
+	}
+
+	SUBCASE("Cancelled read with a deadline does not report a timeout")
+	{
+		std::array<int, 2> sockets{};
+		REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets.data()) == 0);
+		net::FileDescriptor peer(sockets[1]);
+		net::Connection connection(loop, net::FileDescriptor(sockets[0]));
+		int read_error = 0;
+		connection.onRead([](events::ReadEvent &&) { FAIL("Unexpected read"); });
+		connection.onError([&](events::ErrorEvent &&event) {
+			read_error = event.error_code;
+			loop.stop();
+		});
+		REQUIRE(connection.asyncRead(std::chrono::seconds(1)));
+		loop.cancel(sockets[0]);
+
+		loop.run();
+		CHECK(read_error == ECANCELED);
+	}
+}
+
+TEST_CASE("TCP connection churn releases multi-shot reads")
+{
+	static constexpr uint16_t PORT = 4250;
+	static constexpr size_t CONNECTIONS_COUNT = 8;
+
+	EventLoop loop(1024);
+	auto server = loop.resource<net::Acceptor<net::TCP>>();
+	std::vector<std::unique_ptr<net::Connector<net::TCP>>> clients{};
+	std::vector<std::unique_ptr<net::Connection>> server_connections{};
+	std::vector<std::unique_ptr<net::Connection>> client_connections{};
+	const_bytes_t ping = to_bytes("ping");
+	size_t pings_count = 0;
+	size_t end_of_files_count = 0;
+
+	server.onError([](events::ErrorEvent &&event) { FAIL(event.what()); });
+	server.onNewConnection([&](net::Connection &&connection) {
+		auto &server_connection =
+			server_connections.emplace_back(std::make_unique<net::Connection>(std::move(connection)));
+		server_connection->onError([](events::ErrorEvent &&event) { FAIL(event.what()); });
+		server_connection->onRead([&](events::ReadEvent &&event) {
+			CHECK((event.bytes_read == ping));
+			// Every read is armed, and stays so: drop the connections in a later iteration, while the
+			// clients are still connected. Their reads are cancelled, without notifying the connections.
+			if (++pings_count == CONNECTIONS_COUNT)
+				loop.post([&]() { server_connections.clear(); });
+		});
+		server_connection->asyncRead();
+	});
+	REQUIRE(server.listen("127.0.0.1", PORT));
+
+	for (size_t client = 0; client < CONNECTIONS_COUNT; client++) {
+		auto &connector = clients.emplace_back(std::make_unique<net::Connector<net::TCP>>(loop));
+		connector->onError([](events::ErrorEvent &&event) { FAIL(event.what()); });
+		connector->onConnection([&](net::Connection &&connection) {
+			auto &client_connection = client_connections.emplace_back(
+				std::make_unique<net::Connection>(std::move(connection)));
+			client_connection->onError([](events::ErrorEvent &&event) { FAIL(event.what()); });
+			client_connection->onRead([&](events::ReadEvent &&event) {
+				CHECK(event.bytes_read.empty());
+				++end_of_files_count;
+			});
+			client_connection->asyncRead();
+			client_connection->asyncWrite(ping);
+		});
+		connector->asyncConnect("127.0.0.1", PORT);
+	}
+
+	// The peers see the end of file once the server sockets are closed, and their reads end. Only the multi-shot
+	// accept should be left then.
+	int checks_left = 1000;
+	time::Timer check{ [&]() {
+		const bool released = (end_of_files_count == CONNECTIONS_COUNT &&
+				       loop.statistics().active_multishots == 1);
+		if (released || --checks_left == 0)
+			loop.stop();
+		else
+			loop.schedule(check, std::chrono::milliseconds(1));
+	} };
+	loop.schedule(check, std::chrono::milliseconds(1));
+	loop.run();
+
+	CHECK(pings_count == CONNECTIONS_COUNT);
+	CHECK(server_connections.empty());
+	CHECK(end_of_files_count == CONNECTIONS_COUNT);
+	CHECK(loop.statistics().active_multishots == 1);
+}
+
+TEST_CASE("TCP direct accept into the fixed-file table")
+{
+	static constexpr uint16_t PORT = 4251;
+	using Acceptor = net::Acceptor<net::TCP>;
+
+	uring::RingConfig ring_config{};
+	// A single slot: the second client can only be accepted once the first connection freed it.
+	ring_config.fixed_files = 1;
+	EventLoop loop(1024, ring_config);
+
+	auto server = loop.resource<Acceptor>();
+	auto first_client = loop.resource<net::Connector<net::TCP>>();
+	auto second_client = loop.resource<net::Connector<net::TCP>>();
+	std::unique_ptr<net::Connection> server_connection;
+	std::vector<net::Connection> client_connections{};
+	const_bytes_t message = to_bytes("Hello through a fixed file");
+	size_t accepted_count = 0;
+
+	server.onError([](events::ErrorEvent &&event) { FAIL(event.what()); });
+	server.onNewConnection([&](net::Connection &&new_connection) {
+		// The connection is identified by its slot in the table.
+		CHECK(new_connection.endpoint().fd == 0);
+		if (++accepted_count == 2) {
+			loop.stop();
+			return;
+		}
+
+		server_connection = std::make_unique<net::Connection>(std::move(new_connection));
+		server_connection->onError([](events::ErrorEvent &&event) { FAIL(event.what()); });
+		server_connection->onRead([&](events::ReadEvent &&event) {
+			CHECK((event.bytes_read == message));
+			server_connection->asyncWrite(message);
+		});
+		server_connection->onWrite([&](events::WriteEvent &&) {
+			// Frees the slot, before the second client connects.
+			loop.post([&]() {
+				server_connection.reset();
+				second_client.asyncConnect("127.0.0.1", PORT);
+			});
+		});
+		server_connection->asyncRead();
+	});
+	REQUIRE(server.listen("127.0.0.1", PORT, Acceptor::ListeningMode::EXCLUSIVE, Acceptor::AcceptMode::DIRECT));
+
+	auto on_connection = [&](net::Connection &&connection) { client_connections.push_back(std::move(connection)); };
+	first_client.onError([](events::ErrorEvent &&event) { FAIL(event.what()); });
+	first_client.onConnection([&](net::Connection &&connection) {
+		on_connection(std::move(connection));
+		client_connections.back().asyncWrite(message);
+	});
+	second_client.onError([](events::ErrorEvent &&event) { FAIL(event.what()); });
+	second_client.onConnection(on_connection);
+	first_client.asyncConnect("127.0.0.1", PORT);
+
+	loop.run();
+	CHECK(accepted_count == 2);
+}
+
+TEST_CASE("TCP direct accept requires a fixed-file table")
+{
+	using Acceptor = net::Acceptor<net::TCP>;
+	EventLoop loop(64);
+	auto server = loop.resource<Acceptor>();
+	CHECK_FALSE(server.listen("127.0.0.1", 4251, Acceptor::ListeningMode::EXCLUSIVE, Acceptor::AcceptMode::DIRECT));
+}
+
+TEST_CASE("TCP write from registered send buffers")
+{
+	static constexpr uint16_t PORT = 4252;
+
+	uring::RingConfig ring_config{};
+	ring_config.send_buffers = uring::SendBuffers{ .count = 2, .size = 64 };
+	EventLoop loop(1024, ring_config);
+
+	LoopbackPair pair(loop);
+	const std::string_view message = "Hello from a registered buffer";
+	bool written = false;
+	bool read = false;
+
+	pair.on_server_connection = [&](net::Connection &server_connection) {
+		server_connection.onRead([&](events::ReadEvent &&event) {
+			CHECK(to_string(event.bytes_read) == message);
+			read = true;
+			if (written)
+				loop.stop();
+		});
+		server_connection.asyncRead();
+	};
+
+	pair.on_client_connection = [&](net::Connection &client_connection) {
+		client_connection.onWrite([&](events::WriteEvent &&event) {
+			CHECK(to_string(event.bytes_written) == message);
+			written = true;
+			if (read)
+				loop.stop();
+		});
+
+		uring::SendBuffer buffer = loop.leaseSendBuffer();
+		REQUIRE(buffer);
+		{
+			// Dropped without being written: back to the pool right away.
+			uring::SendBuffer other = loop.leaseSendBuffer();
+			REQUIRE(other);
+			CHECK_FALSE(loop.leaseSendBuffer());
+		}
+		CHECK(loop.leaseSendBuffer());
+
+		std::ranges::copy(to_bytes(message), buffer.bytes().begin());
+		const size_t buffer_size = buffer.bytes().size();
+		CHECK_FALSE(client_connection.asyncWrite(std::move(buffer), buffer_size + 1));
+		REQUIRE(buffer);
+		REQUIRE(client_connection.asyncWrite(std::move(buffer), message.size()));
+	};
+	pair.connect(PORT);
+
+	loop.run();
+	CHECK(written);
+	// The written buffer was given back to the pool.
+	uring::SendBuffer first = loop.leaseSendBuffer();
+	uring::SendBuffer second = loop.leaseSendBuffer();
+	CHECK((first && second));
+}
+
+TEST_CASE("TCP zero-copy send")
+{
+	static constexpr uint16_t PORT = 4253;
+	static constexpr size_t PAYLOAD_SIZE = 64 * 1024;
+
+	EventLoop loop(1024);
+	LoopbackPair pair(loop);
+
+	std::vector<std::byte> payload(PAYLOAD_SIZE);
+	for (size_t index = 0; index < payload.size(); index++)
+		payload[index] = static_cast<std::byte>(index % 251);
+	std::vector<std::byte> received{};
+	size_t sent_count = 0;
+
+	auto stop_when_done = [&]() {
+		if (sent_count > 0 && received.size() == sent_count)
+			loop.stop();
+	};
+
+	pair.on_server_connection = [&](net::Connection &server_connection) {
+		server_connection.onRead([&](events::ReadEvent &&event) {
+			received.insert(received.end(), event.bytes_read.begin(), event.bytes_read.end());
+			stop_when_done();
+		});
+		server_connection.asyncRead();
+	};
+
+	pair.on_client_connection = [&](net::Connection &client_connection) {
+		// Notified once, after the notification completion: the payload is no longer in use.
+		client_connection.onWrite([&](events::WriteEvent &&event) {
+			CHECK(sent_count == 0);
+			CHECK(event.bytes_written.data() == payload.data());
+			sent_count = event.bytes_written.size();
+			stop_when_done();
+		});
+		REQUIRE(client_connection.asyncSendZeroCopy(payload));
+	};
+	pair.connect(PORT);
+
+	loop.run();
+	REQUIRE(sent_count > 0);
+	CHECK(std::equal(received.begin(), received.end(), payload.begin()));
+}
+
+TEST_CASE("TCP write queue delivers complete spans in order")
+{
+	static constexpr uint16_t PORT = 4254;
+	static constexpr size_t SPANS_COUNT = 16;
+	static constexpr size_t SPAN_SIZE = 256 * 1024;
+
+	EventLoop loop(1024);
+	LoopbackPair pair(loop);
+
+	std::vector<std::byte> payload(SPANS_COUNT * SPAN_SIZE);
+	for (size_t index = 0; index < payload.size(); index++)
+		payload[index] = static_cast<std::byte>((index / SPAN_SIZE) * 7 + index % 13);
+	std::vector<std::byte> received{};
+	std::vector<const std::byte *> completed_spans{};
+	size_t high_watermarks = 0;
+	size_t low_watermarks = 0;
+
+	pair.on_server_connection = [&](net::Connection &server_connection) {
+		server_connection.onRead([&](events::ReadEvent &&event) {
+			received.insert(received.end(), event.bytes_read.begin(), event.bytes_read.end());
+			if (received.size() == payload.size())
+				loop.stop();
+		});
+		server_connection.asyncRead();
+	};
+
+	pair.on_client_connection = [&](net::Connection &client_connection) {
+		client_connection.onWrite([&](events::WriteEvent &&event) {
+			// Each span is notified once, completely written.
+			CHECK(event.bytes_written.size() == SPAN_SIZE);
+			completed_spans.push_back(event.bytes_written.data());
+		});
+		client_connection.setWriteWatermarks(SPAN_SIZE, 4 * SPAN_SIZE);
+		client_connection.onHighWatermark([&]() { ++high_watermarks; });
+		client_connection.onLowWatermark([&]() { ++low_watermarks; });
+
+		const std::span<const std::byte> bytes{ payload };
+		for (size_t span = 0; span < SPANS_COUNT; span++)
+			REQUIRE(client_connection.enqueueWrite(bytes.subspan(span * SPAN_SIZE, SPAN_SIZE)));
+		CHECK(client_connection.queuedBytes() == payload.size());
+	};
+	pair.connect(PORT);
+
+	loop.run();
+	REQUIRE(received.size() == payload.size());
+	CHECK((received == payload));
+	REQUIRE(completed_spans.size() == SPANS_COUNT);
+	for (size_t span = 0; span < SPANS_COUNT; span++)
+		CHECK(completed_spans[span] == payload.data() + span * SPAN_SIZE);
+	CHECK(pair.client_connection->queuedBytes() == 0);
+	CHECK(high_watermarks == 1);
+	CHECK(low_watermarks == 1);
+}
+
+TEST_CASE("TCP write queue resumes once the request queue has room")
+{
+	static constexpr uint16_t PORT = 4260;
+
+	EventLoop loop(8);
+	LoopbackPair pair(loop);
+
+	const std::string queued = "queued;";
+	const std::string filler = "filler;";
+	size_t expected_size = 0;
+	size_t received_size = 0;
+	size_t queued_writes = 0;
+
+	pair.on_server_connection = [&](net::Connection &server_connection) {
+		server_connection.onRead([&](events::ReadEvent &&event) {
+			received_size += event.bytes_read.size();
+			if (received_size == expected_size && queued_writes == 2)
+				loop.stop();
+		});
+		server_connection.asyncRead();
+	};
+
+	pair.on_client_connection = [&](net::Connection &client_connection) {
+		// A transient shortage of write requests is not an error.
+		client_connection.onWrite([&](events::WriteEvent &&event) {
+			if (to_string(event.bytes_written) == queued)
+				++queued_writes;
+		});
+		REQUIRE(client_connection.enqueueWrite(to_bytes(queued)));
+		REQUIRE(client_connection.enqueueWrite(to_bytes(queued)));
+		expected_size = 2 * queued.size();
+		// Every other write request is in use once the first queued write completes: the second one waits.
+		while (client_connection.asyncWrite(to_bytes(filler)))
+			expected_size += filler.size();
+	};
+	pair.connect(PORT);
+
+	loop.run();
+	CHECK(queued_writes == 2);
+	CHECK(received_size == expected_size);
+	CHECK(pair.client_connection->queuedBytes() == 0);
+}
+
+TEST_CASE("TCP vectored write")
+{
+	static constexpr uint16_t PORT = 4255;
+
+	EventLoop loop(1024);
+	LoopbackPair pair(loop);
+
+	const std::string header = "[header]";
+	const std::string body = "Hello in three parts";
+	const std::string trailer = "[trailer]";
+	auto as_iovec = [](const std::string &part) {
+		return iovec{ .iov_base = const_cast<char *>(part.data()), .iov_len = part.size() };
+	};
+	const std::array<iovec, 3> frame{ as_iovec(header), as_iovec(body), as_iovec(trailer) };
+	const std::string expected = header + body + trailer;
+	std::string received{};
+	size_t written = 0;
+	auto stop_when_done = [&]() {
+		if (written > 0 && received.size() == written)
+			loop.stop();
+	};
+
+	pair.on_server_connection = [&](net::Connection &server_connection) {
+		server_connection.onRead([&](events::ReadEvent &&event) {
+			received += to_string(event.bytes_read);
+			stop_when_done();
+		});
+		server_connection.asyncRead();
+	};
+
+	pair.on_client_connection = [&](net::Connection &client_connection) {
+		client_connection.onWrite([&](events::WriteEvent &&event) {
+			CHECK(event.buffers.size() == frame.size());
+			CHECK(event.bytes_written.empty());
+			written = event.vectored_size;
+			stop_when_done();
+		});
+		REQUIRE(client_connection.asyncWritev(frame));
+	};
+	pair.connect(PORT);
+
+	loop.run();
+	CHECK(received == expected);
+	CHECK(written == expected.size());
+}
+
+TEST_CASE("TCP corked writes are gathered")
+{
+	static constexpr uint16_t PORT = 4256;
+	static constexpr size_t WRITES_COUNT = 10;
+
+	EventLoop loop(1024);
+	LoopbackPair pair(loop);
+
+	std::vector<std::string> messages{};
+	std::string expected{};
+	for (size_t index = 0; index < WRITES_COUNT; index++) {
+		messages.push_back("Small message #" + std::to_string(index) + ";");
+		expected += messages.back();
+	}
+	std::string received{};
+	size_t reads_count = 0;
+	size_t writes_notified = 0;
+	auto stop_when_done = [&]() {
+		if (writes_notified == WRITES_COUNT && received.size() == expected.size())
+			loop.stop();
+	};
+
+	pair.on_server_connection = [&](net::Connection &server_connection) {
+		server_connection.onRead([&](events::ReadEvent &&event) {
+			received += to_string(event.bytes_read);
+			++reads_count;
+			stop_when_done();
+		});
+		server_connection.asyncRead();
+	};
+
+	pair.on_client_connection = [&](net::Connection &client_connection) {
+		client_connection.onWrite([&](events::WriteEvent &&event) {
+			// Each write is notified on its own, in order.
+			CHECK(to_string(event.bytes_written) == messages[writes_notified]);
+			++writes_notified;
+			stop_when_done();
+		});
+		client_connection.setCorked(true);
+		for (const std::string &message : messages)
+			REQUIRE(client_connection.asyncWrite(to_bytes(message)));
+	};
+	pair.connect(PORT);
+
+	loop.run();
+	CHECK(received == expected);
+	// Sent at once, by a single vectored write.
+	CHECK(reads_count == 1);
+}
+
+TEST_CASE("TCP corked writes beyond IOV_MAX are split")
+{
+	static constexpr uint16_t PORT = 4261;
+	static constexpr size_t WRITES_COUNT = IOV_MAX + 500;
+
+	EventLoop loop(1024);
+	LoopbackPair pair(loop);
+
+	std::vector<std::string> messages{};
+	std::string expected{};
+	for (size_t index = 0; index < WRITES_COUNT; index++) {
+		messages.push_back("#" + std::to_string(index) + ";");
+		expected += messages.back();
+	}
+	std::string received{};
+	size_t writes_notified = 0;
+	auto stop_when_done = [&]() {
+		if (writes_notified == WRITES_COUNT && received.size() == expected.size())
+			loop.stop();
+	};
+
+	pair.on_server_connection = [&](net::Connection &server_connection) {
+		server_connection.onRead([&](events::ReadEvent &&event) {
+			received += to_string(event.bytes_read);
+			stop_when_done();
+		});
+		server_connection.asyncRead();
+	};
+
+	pair.on_client_connection = [&](net::Connection &client_connection) {
+		client_connection.onWrite([&](events::WriteEvent &&event) {
+			CHECK(to_string(event.bytes_written) == messages[writes_notified]);
+			++writes_notified;
+			stop_when_done();
+		});
+		client_connection.setCorked(true);
+		for (const std::string &message : messages)
+			REQUIRE(client_connection.asyncWrite(to_bytes(message)));
+	};
+	pair.connect(PORT);
+
+	loop.run();
+	CHECK(writes_notified == WRITES_COUNT);
+	CHECK(received == expected);
+}
+
+TEST_CASE("TCP short corked writes are resumed in order")
+{
+	static constexpr uint16_t PORT = 4263;
+	static constexpr size_t WRITES_COUNT = 8;
+	static constexpr size_t WRITE_SIZE = 256 * 1024;
+
+	EventLoop loop(1024);
+	LoopbackPair pair(loop);
+
+	std::vector<std::string> messages{};
+	std::string expected{};
+	for (size_t index = 0; index < WRITES_COUNT; index++) {
+		messages.emplace_back(WRITE_SIZE, static_cast<char>('a' + index));
+		expected += messages.back();
+	}
+	std::string received{};
+	size_t writes_notified = 0;
+	auto stop_when_done = [&]() {
+		if (writes_notified == WRITES_COUNT && received.size() == expected.size())
+			loop.stop();
+	};
+
+	pair.on_server_connection = [&](net::Connection &server_connection) {
+		server_connection.onRead([&](events::ReadEvent &&event) {
+			received += to_string(event.bytes_read);
+			stop_when_done();
+		});
+		server_connection.asyncRead();
+	};
+
+	pair.on_client_connection = [&](net::Connection &client_connection) {
+		// A small send buffer, so the vectored write of all the messages comes back short.
+		int send_buffer_size = 4096;
+		REQUIRE(::setsockopt(client_connection.endpoint().fd, SOL_SOCKET, SO_SNDBUF, &send_buffer_size,
+				     sizeof(send_buffer_size)) == 0);
+		client_connection.onWrite([&](events::WriteEvent &&event) {
+			// Notified once, completely written, in order: the rest of a short write comes first.
+			REQUIRE(writes_notified < WRITES_COUNT);
+			CHECK(event.bytes_written.size() == WRITE_SIZE);
+			CHECK(to_string(event.bytes_written) == messages[writes_notified]);
+			++writes_notified;
+			stop_when_done();
+		});
+		client_connection.setCorked(true);
+		for (const std::string &message : messages)
+			REQUIRE(client_connection.asyncWrite(to_bytes(message)));
+	};
+	pair.connect(PORT);
+
+	loop.run();
+	CHECK(writes_notified == WRITES_COUNT);
+	CHECK(received == expected);
+}
+
+TEST_CASE("TCP bundled reads span several provided buffers")
+{
+	static constexpr uint16_t PORT = 4257;
+	static constexpr size_t SENT_SIZE = 16 * 1024;
+
+	EventLoop loop(1024);
+	if (!loop.supportsReceiveBundles()) {
+		MESSAGE("Skipped: the kernel does not support bundled receives");
+		return;
+	}
+
+	LoopbackPair pair(loop);
+
+	std::string expected(SENT_SIZE, '\0');
+	for (size_t index = 0; index < expected.size(); index++)
+		expected[index] = static_cast<char>('a' + index % 26);
+	std::string received{};
+	size_t reads_count = 0;
+	size_t buffers_count = 0;
+
+	pair.on_server_connection = [&](net::Connection &server_connection) {
+		server_connection.onRead([&](events::ReadEvent &&event) {
+			REQUIRE(!event.buffers.empty());
+			CHECK(event.bytes_read.data() == event.buffers.front().data());
+			for (std::span<const std::byte> buffer : event.buffers)
+				received += to_string(buffer);
+			++reads_count;
+			buffers_count += event.buffers.size();
+			if (received.size() == expected.size())
+				loop.stop();
+		});
+		REQUIRE(server_connection.asyncReadBundles());
+	};
+
+	pair.on_client_connection = [&](net::Connection &client_connection) {
+		REQUIRE(client_connection.enqueueWrite(to_bytes(expected)));
+	};
+	pair.connect(PORT);
+
+	loop.run();
+	CHECK(received == expected);
+	// Several buffers per completion.
+	CHECK(reads_count < buffers_count);
+}
+
+TEST_CASE("TCP reads consume provided buffers incrementally")
+{
+	static constexpr uint16_t PORT = 4258;
+	static constexpr size_t MESSAGES_COUNT = 8;
+
+	uring::RingConfig config{};
+	config.provided_buffers = { uring::ProvidedBuffers{ .count = 16, .size = 64 * 1024, .incremental = true } };
+	EventLoop loop(1024, config);
+	if (!loop.incrementalBuffers()) {
+		MESSAGE("Skipped: the kernel does not support incremental buffer consumption");
+		return;
+	}
+
+	LoopbackPair pair(loop);
+
+	std::vector<std::string> messages{};
+	for (size_t index = 0; index < MESSAGES_COUNT; index++)
+		messages.push_back("Message #" + std::to_string(index));
+	std::vector<std::string> received{};
+	std::span<const std::byte> previous_read{};
+
+	pair.on_server_connection = [&](net::Connection &server_connection) {
+		server_connection.onRead([&](events::ReadEvent &&event) {
+			// Each read goes on filling the buffer, right after the previous one.
+			if (!previous_read.empty())
+				CHECK(event.bytes_read.data() == previous_read.data() + previous_read.size());
+			previous_read = event.bytes_read;
+			received.push_back(to_string(event.bytes_read));
+			if (received.size() == MESSAGES_COUNT)
+				loop.stop();
+			else
+				REQUIRE(pair.client_connection->asyncWrite(to_bytes(messages[received.size()])));
+		});
+		server_connection.asyncRead();
+	};
+
+	pair.on_client_connection = [&](net::Connection &client_connection) {
+		REQUIRE(client_connection.asyncWrite(to_bytes(messages.front())));
+	};
+	pair.connect(PORT);
+
+	loop.run();
+	CHECK(received == messages);
+}
+
+TEST_CASE("TCP connections are promoted to larger provided buffers")
+{
+	static constexpr uint16_t PORT = 4259;
+	static constexpr size_t SENT_SIZE = 64 * 1024;
+
+	uring::RingConfig config{};
+	config.provided_buffers = { uring::ProvidedBuffers{ .count = 64, .size = 512 },
+				    uring::ProvidedBuffers{ .count = 64, .size = 4096 } };
+	EventLoop loop(1024, config);
+	REQUIRE(loop.bufferClassesCount() == 2);
+	CHECK(loop.bufferSize(1) == 4096);
+
+	LoopbackPair pair(loop);
+
+	std::string expected(SENT_SIZE, '\0');
+	for (size_t index = 0; index < expected.size(); index++)
+		expected[index] = static_cast<char>('a' + index % 26);
+	std::string received{};
+	size_t largest_read = 0;
+
+	pair.on_server_connection = [&](net::Connection &server_connection) {
+		// Errors fail the test: the cancellation of the read armed in the smaller class is not notified.
+		server_connection.onRead([&](events::ReadEvent &&event) {
+			received += to_string(event.bytes_read);
+			largest_read = std::max(largest_read, event.bytes_read.size());
+			if (received.size() == expected.size())
+				loop.stop();
+		});
+		server_connection.setBufferPromotion(true);
+		server_connection.asyncRead();
+	};
+
+	pair.on_client_connection = [&](net::Connection &client_connection) {
+		REQUIRE(client_connection.enqueueWrite(to_bytes(expected)));
+	};
+	pair.connect(PORT);
+
+	loop.run();
+	CHECK(received == expected);
+	CHECK(pair.server_connection->bufferClass() == 1);
+	CHECK(largest_read > 512);
+}
+
+TEST_CASE("TCP read running out of buffers while moved to another size class")
+{
+	static constexpr uint16_t PORT = 4262;
+	static constexpr size_t SENT_SIZE = 64 * 1024;
+
+	uring::RingConfig config{};
+	config.provided_buffers = { uring::ProvidedBuffers{ .count = 2, .size = 512 },
+				    uring::ProvidedBuffers{ .count = 64, .size = 4096 } };
+	EventLoop loop(1024, config);
+
+	LoopbackPair pair(loop);
+
+	std::string expected(SENT_SIZE, '\0');
+	for (size_t index = 0; index < expected.size(); index++)
+		expected[index] = static_cast<char>('a' + index % 26);
+	std::string received{};
+	bool written = false;
+	// Armed once all the bytes are received: the read fills both small buffers, then runs out of them (ENOBUFS),
+	// all before the completions are handled.
+	auto read_when_written = [&]() {
+		if (pair.server_connection && written)
+			REQUIRE(pair.server_connection->asyncRead());
+	};
+
+	pair.on_server_connection = [&](net::Connection &server_connection) {
+		// Errors fail the test: the read terminated before its cancellation is armed again in the larger
+		// class, and not cancelled.
+		server_connection.onRead([&](events::ReadEvent &&event) {
+			received += to_string(event.bytes_read);
+			if (server_connection.bufferClass() == 0)
+				server_connection.setBufferClass(1);
+			if (received.size() == expected.size())
+				loop.stop();
+		});
+		read_when_written();
+	};
+
+	pair.on_client_connection = [&](net::Connection &client_connection) {
+		client_connection.onWrite([&](events::WriteEvent &&) {
+			written = true;
+			read_when_written();
+		});
+		REQUIRE(client_connection.enqueueWrite(to_bytes(expected)));
+	};
+	pair.connect(PORT);
+
+	loop.run();
+	CHECK(received == expected);
+	CHECK(pair.server_connection->bufferClass() == 1);
+}
@@ -0,0 +1,155 @@
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <doctest.h>
+
+#include "ringnet/eventLoop.hpp"
+#include "ringnet/time/timerWheel.hpp"
+
+using namespace ringnet;
+using namespace std::chrono_literals;
+using Clock = time::TimerWheel::Clock;
+
+TEST_CASE("Timer wheel")
+{
+	const Clock::time_point origin = Clock::now();
+	time::TimerWheel wheel(1ms, origin);
+
+	SUBCASE("Timers expire in order, never early")
+	{
+		std::vector<int> expired{};
+		time::Timer first([&expired]() { expired.push_back(1); });
+		time::Timer second([&expired]() { expired.push_back(2); });
+		time::Timer third([&expired]() { expired.push_back(3); });
+
+		wheel.schedule(third, origin + 300ms);
+		wheel.schedule(first, origin + 10ms);
+		wheel.schedule(second, origin + 10500us);
+		CHECK(wheel.size() == 3);
+		CHECK(wheel.nextDeadline() == origin + 10ms);
+
+		CHECK(wheel.advance(origin + 9ms) == 0);
+		CHECK(wheel.advance(origin + 10ms) == 1);
+		CHECK(wheel.advance(origin + 299ms) == 1);
+		CHECK(third.scheduled());
+		CHECK(wheel.advance(origin + 300ms) == 1);
+		CHECK(expired == std::vector<int>{ 1, 2, 3 });
+		CHECK(wheel.empty());
+	}
+
+	SUBCASE("Cancelled and rescheduled timers")
+	{
+		int expired_count = 0;
+		time::Timer cancelled([&expired_count]() { ++expired_count; });
+		time::Timer rescheduled([&expired_count]() { ++expired_count; });
+
+		wheel.schedule(cancelled, origin + 5ms);
+		wheel.schedule(rescheduled, origin + 5ms);
+		wheel.cancel(cancelled);
+		wheel.schedule(rescheduled, origin + 50ms);
+		CHECK(wheel.size() == 1);
+
+		CHECK(wheel.advance(origin + 49ms) == 0);
+		CHECK(wheel.advance(origin + 50ms) == 1);
+		CHECK(expired_count == 1);
+	}
+
+	SUBCASE("Timers of the upper levels are cascaded down")
+	{
+		// Spread over the first three levels, with deadlines falling right on level boundaries.
+		const std::vector<Clock::duration> delays{ 255ms, 256ms, 257ms, 65535ms, 65536ms, 70s, 20min };
+		std::vector<Clock::duration> expired{};
+		std::vector<std::unique_ptr<time::Timer>> timers{};
+		for (Clock::duration delay : delays) {
+			auto on_expiry = [&expired, delay]() { expired.push_back(delay); };
+			timers.push_back(std::make_unique<time::Timer>(on_expiry));
+			wheel.schedule(*timers.back(), origin + delay);
+		}
+
+		for (Clock::duration delay : delays) {
+			// The actual expiry, rather than the next cascade.
+			CHECK(wheel.nextDeadline() == origin + delay);
+			CHECK(wheel.advance(origin + delay - 1ms) == 0);
+			CHECK(wheel.advance(origin + delay) == 1);
+		}
+		CHECK(expired == delays);
+	}
+
+	SUBCASE("Cancelled timers of the upper levels only bring the next deadline earlier")
+	{
+		int expired_count = 0;
+		time::Timer cancelled([&expired_count]() { ++expired_count; });
+		time::Timer kept([&expired_count]() { ++expired_count; });
+
+		// Both in the same slot of the second level.
+		wheel.schedule(cancelled, origin + 300ms);
+		wheel.schedule(kept, origin + 400ms);
+		CHECK(wheel.nextDeadline() == origin + 300ms);
+		wheel.cancel(cancelled);
+		CHECK(wheel.nextDeadline() <= origin + 400ms);
+
+		// Once cascaded down, exact again.
+		CHECK(wheel.advance(*wheel.nextDeadline()) == 0);
+		CHECK(wheel.nextDeadline() == origin + 400ms);
+		CHECK(wheel.advance(origin + 400ms) == 1);
+		CHECK(expired_count == 1);
+	}
+
+	SUBCASE("Callbacks can reschedule their timer")
+	{
+		int expired_count = 0;
+		time::Timer periodic{};
+		periodic.onExpiry([&]() {
+			if (++expired_count < 10)
+				wheel.schedule(periodic, origin + (expired_count + 1) * 10ms);
+		});
+		wheel.schedule(periodic, origin + 10ms);
+
+		CHECK(wheel.advance(origin + 1s) == 10);
+		CHECK(expired_count == 10);
+	}
+
+	SUBCASE("Destroyed timers are cancelled")
+	{
+		{
+			time::Timer destroyed{};
+			wheel.schedule(destroyed, origin + 10ms);
+		}
+		CHECK(wheel.empty());
+		CHECK(wheel.advance(origin + 1s) == 0);
+	}
+}
+
+TEST_CASE("Event loop timers")
+{
+	EventLoop loop(64);
+	// Long enough for the test to time out if timers waited for the loop to wake up on its own.
+	loop.setIdleStrategy(IdleStrategy::block(5s));
+
+	std::vector<int> expired{};
+	time::Timer first([&expired]() { expired.push_back(1); });
+	time::Timer cancelled([&expired]() { expired.push_back(0); });
+	time::Timer last([&]() {
+		expired.push_back(2);
+		loop.stop();
+	});
+
+	// The earliest timer is scheduled last: the timeout armed for the later one needs to be moved.
+	const Clock::time_point start = Clock::now();
+	loop.post([&]() {
+		loop.schedule(last, 60ms);
+		loop.schedule(cancelled, 30ms);
+		loop.post([&]() {
+			loop.schedule(first, 20ms);
+			loop.cancel(cancelled);
+		});
+	});
+	loop.run();
+
+	const Clock::duration elapsed = Clock::now() - start;
+	CHECK(expired == std::vector<int>{ 1, 2 });
+	CHECK(elapsed >= 60ms);
+	CHECK(elapsed < 1s);
+}
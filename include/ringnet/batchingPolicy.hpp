@@ -0,0 +1,30 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+namespace ringnet
+{
+
+/// @brief When an event loop submits the requests it prepared. Requests are submitted once at least min_batch_size of
+/// them are waiting, once the oldest one waited for max_delay, or right away if any of them is urgent
+/// (uring::URGENT flag). An idle loop wakes up in time to honor the delay.
+/// - immediate(): submit at every iteration. Lowest latency.
+/// - batch(size, delay): fewer, larger submissions (hence fewer syscalls), at the cost of up to the given delay.
+/// @note Ignored with submission polling: the kernel thread picks requests up as soon as they are prepared.
+struct BatchingPolicy {
+	size_t min_batch_size = 1;
+	std::chrono::microseconds max_delay{ 0 };
+
+	static constexpr BatchingPolicy immediate()
+	{
+		return BatchingPolicy{};
+	}
+
+	static constexpr BatchingPolicy batch(size_t min_batch_size, std::chrono::microseconds max_delay)
+	{
+		return BatchingPolicy{ .min_batch_size = min_batch_size, .max_delay = max_delay };
+	}
+};
+
+} // namespace ringnet
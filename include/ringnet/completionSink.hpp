@@ -0,0 +1,32 @@
+#pragma once
+
+#include <variant>
+
+#include "ringnet/events.hpp"
+
+namespace ringnet
+{
+
+/// @brief Target of a request completion, notified directly from the completion dispatch through a plain function
+/// pointer: no type-erased callable nor lock in between, unlike a Subscriber. Used to resume coroutines.
+/// Derive from it, and point the notification function to a static member function of the derived type.
+struct CompletionSink {
+	using Event = std::variant<events::ErrorEvent, events::AcceptEvent, events::ReadEvent, events::WriteEvent,
+				   events::ConnectEvent>;
+	using Notify = void (*)(CompletionSink &sink, Event &&event);
+
+	Notify notify = nullptr;
+};
+
+/// @brief Target of a flush, run by the loop once per iteration, right before submitting: lets requests issued
+/// during an iteration be coalesced into fewer ones (e.g. corked writes). Notified through a plain function pointer,
+/// like CompletionSink.
+struct FlushSink {
+	using Flush = void (*)(FlushSink &sink);
+
+	Flush flush = nullptr;
+	/// @brief Set while scheduled, until flushed or cancelled.
+	bool scheduled = false;
+};
+
+} // namespace ringnet
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+#include <utility>
+
+namespace ringnet::coro
+{
+
+/// @brief Memory of coroutine frames. Each event loop owns one, made current on its thread while it runs: the frames
+/// of the coroutines created there are recycled by the pool, instead of going through the global heap each time.
+/// Frames created while no pool is current come from the global heap.
+/// @warning Not thread-safe: a frame must be freed on the thread of the pool it comes from, and before the pool is
+/// destroyed.
+class FramePool {
+	/// @brief Each frame is prefixed with the pool it comes from (or nullptr), keeping the frame alignment.
+	static constexpr size_t HEADER_SIZE = alignof(std::max_align_t);
+	static_assert(HEADER_SIZE >= sizeof(FramePool *));
+
+	std::pmr::unsynchronized_pool_resource resource{};
+
+	static inline thread_local FramePool *current_pool = nullptr;
+
+    public:
+	FramePool() = default;
+	FramePool(const FramePool &) = delete;
+	FramePool &operator=(const FramePool &) = delete;
+
+	/// @brief Make the pool current on the calling thread, for the lifetime of the scope.
+	class Scope {
+		FramePool *previous;
+
+	    public:
+		explicit Scope(FramePool &pool) : previous(std::exchange(current_pool, &pool))
+		{
+		}
+		~Scope()
+		{
+			current_pool = previous;
+		}
+		Scope(const Scope &) = delete;
+		Scope &operator=(const Scope &) = delete;
+	};
+
+	static FramePool *current()
+	{
+		return current_pool;
+	}
+
+	static void *allocate(size_t size)
+	{
+		FramePool *pool = current_pool;
+		const size_t total_size = HEADER_SIZE + size;
+		std::byte *memory = static_cast<std::byte *>(
+			pool ? pool->resource.allocate(total_size, HEADER_SIZE) : ::operator new(total_size));
+		*reinterpret_cast<FramePool **>(memory) = pool;
+		return memory + HEADER_SIZE;
+	}
+
+	static void deallocate(void *frame, size_t size)
+	{
+		std::byte *memory = static_cast<std::byte *>(frame) - HEADER_SIZE;
+		FramePool *pool = *reinterpret_cast<FramePool **>(memory);
+		if (pool)
+			pool->resource.deallocate(memory, HEADER_SIZE + size, HEADER_SIZE);
+		else
+			::operator delete(memory);
+	}
+};
+
+} // namespace ringnet::coro
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <coroutine>
+
+#include <tl/expected.hpp>
+
+#include "ringnet/completionSink.hpp"
+#include "ringnet/eventLoop.hpp"
+#include "ringnet/events.hpp"
+
+namespace ringnet::coro
+{
+
+/// @brief Awaitable request: submitted when awaited, and resuming the awaiting coroutine right from the completion
+/// dispatch of the event loop.
+/// Destroyed while suspended (the frame of the awaiting coroutine being destroyed before the completion), the
+/// operation detaches its request: the completion is then ignored, rather than resuming the destroyed coroutine.
+/// The bytes the request refers to must still outlive the completion.
+/// @tparam SuccessEvent Event notified on success.
+/// @tparam Request Type of the request.
+template <class SuccessEvent, class Request>
+class Operation : public CompletionSink {
+    public:
+	using Result = tl::expected<SuccessEvent, events::ErrorEvent>;
+
+	Operation(EventLoop &loop_, const Request &request_)
+		: CompletionSink{ &Operation::deliver }, loop(loop_), request(request_)
+	{
+	}
+
+	Operation(const Operation &) = delete;
+	Operation &operator=(const Operation &) = delete;
+
+	~Operation()
+	{
+		if (pending)
+			EventLoop::detach(*pending);
+	}
+
+	bool await_ready() const noexcept
+	{
+		return false;
+	}
+
+	bool await_suspend(std::coroutine_handle<> continuation_)
+	{
+		continuation = continuation_;
+		pending = loop.push(std::move(request), static_cast<CompletionSink *>(this));
+		if (!pending) {
+			result = tl::unexpected(events::ErrorEvent{ .error_code = EAGAIN });
+			return false;
+		}
+		return true;
+	}
+
+	Result await_resume()
+	{
+		return std::move(result);
+	}
+
+    private:
+	EventLoop &loop;
+	Request request;
+	std::coroutine_handle<> continuation{};
+	/// @brief Request in flight while suspended, if any.
+	uring::RequestHeader *pending = nullptr;
+	Result result{ tl::unexpected(events::ErrorEvent{}) };
+
+	static void deliver(CompletionSink &sink, CompletionSink::Event &&event)
+	{
+		Operation &self = static_cast<Operation &>(sink);
+		self.pending = nullptr;
+		if (const events::ErrorEvent *error = std::get_if<events::ErrorEvent>(&event))
+			self.result = tl::unexpected(*error);
+		else
+			self.result = std::get<SuccessEvent>(std::move(event));
+		// The awaiting coroutine (owning this awaiter) may complete before returning: do not touch self beyond.
+		self.continuation.resume();
+	}
+};
+
+} // namespace ringnet::coro
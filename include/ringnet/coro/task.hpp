@@ -0,0 +1,207 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+#include "ringnet/coro/framePool.hpp"
+
+namespace ringnet::coro
+{
+template <class T>
+class Task;
+
+namespace detail
+{
+/// @brief Once completed, resume the awaiting coroutine, if any (symmetric transfer: no stack growth).
+struct FinalAwaiter {
+	bool await_ready() const noexcept
+	{
+		return false;
+	}
+
+	template <class Promise>
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) const noexcept
+	{
+		if (std::coroutine_handle<> continuation = handle.promise().continuation)
+			return continuation;
+		return std::noop_coroutine();
+	}
+
+	void await_resume() const noexcept
+	{
+	}
+};
+
+struct PromiseBase {
+	std::coroutine_handle<> continuation{};
+	std::exception_ptr exception{};
+
+	std::suspend_always initial_suspend() const noexcept
+	{
+		return {};
+	}
+
+	FinalAwaiter final_suspend() const noexcept
+	{
+		return {};
+	}
+
+	void unhandled_exception() noexcept
+	{
+		exception = std::current_exception();
+	}
+
+	static void *operator new(size_t size)
+	{
+		return FramePool::allocate(size);
+	}
+
+	static void operator delete(void *frame, size_t size)
+	{
+		FramePool::deallocate(frame, size);
+	}
+};
+
+template <class T>
+struct Promise : PromiseBase {
+	std::optional<T> value{};
+
+	Task<T> get_return_object() noexcept;
+
+	template <class U>
+	void return_value(U &&value_)
+	{
+		value.emplace(std::forward<U>(value_));
+	}
+
+	T result()
+	{
+		if (exception)
+			std::rethrow_exception(exception);
+		return std::move(*value);
+	}
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+	Task<void> get_return_object() noexcept;
+
+	void return_void() const noexcept
+	{
+	}
+
+	void result()
+	{
+		if (exception)
+			std::rethrow_exception(exception);
+	}
+};
+} // namespace detail
+
+/// @brief Lazy coroutine: starts once awaited, and resumes its awaiter once completed. Exceptions are rethrown to the
+/// awaiter. Its frame comes from the current frame pool, if any (cf. FramePool).
+template <class T = void>
+class [[nodiscard]] Task {
+    public:
+	using promise_type = detail::Promise<T>;
+	using Handle = std::coroutine_handle<promise_type>;
+
+	explicit Task(Handle handle_) : handle(handle_)
+	{
+	}
+
+	Task(Task &&other) noexcept : handle(std::exchange(other.handle, nullptr))
+	{
+	}
+
+	Task &operator=(Task &&other) noexcept
+	{
+		if (this != &other) {
+			if (handle)
+				handle.destroy();
+			handle = std::exchange(other.handle, nullptr);
+		}
+		return *this;
+	}
+
+	Task(const Task &) = delete;
+	Task &operator=(const Task &) = delete;
+
+	~Task()
+	{
+		if (handle)
+			handle.destroy();
+	}
+
+	auto operator co_await() noexcept
+	{
+		struct Awaiter {
+			Handle handle;
+
+			bool await_ready() const noexcept
+			{
+				return !handle || handle.done();
+			}
+
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) const noexcept
+			{
+				handle.promise().continuation = continuation;
+				return handle;
+			}
+
+			T await_resume() const
+			{
+				return handle.promise().result();
+			}
+		};
+		return Awaiter{ handle };
+	}
+
+    private:
+	Handle handle;
+};
+
+template <class T>
+Task<T> detail::Promise<T>::get_return_object() noexcept
+{
+	return Task<T>{ std::coroutine_handle<Promise<T>>::from_promise(*this) };
+}
+
+inline Task<void> detail::Promise<void>::get_return_object() noexcept
+{
+	return Task<void>{ std::coroutine_handle<Promise<void>>::from_promise(*this) };
+}
+
+/// @brief Eager, fire-and-forget coroutine: runs until its first suspension when called, and frees its frame once
+/// completed. Its body must not throw.
+struct Detached {
+	struct promise_type : detail::PromiseBase {
+		Detached get_return_object() const noexcept
+		{
+			return {};
+		}
+
+		std::suspend_never initial_suspend() const noexcept
+		{
+			return {};
+		}
+
+		std::suspend_never final_suspend() const noexcept
+		{
+			return {};
+		}
+
+		void return_void() const noexcept
+		{
+		}
+
+		void unhandled_exception() const noexcept
+		{
+			std::terminate();
+		}
+	};
+};
+
+} // namespace ringnet::coro
@@ -2,8 +2,8 @@
 
 #include <iostream>
 
-#include "ringnet/eventHandler.hpp"
 #include "ringnet/events.hpp"
+#include "ringnet/inlineCallback.hpp"
 
 namespace ringnet
 {
@@ -28,7 +28,8 @@ class Error {
 
 /// @brief A class to handle errors:
 /// - set the appropriate callback to call when an error occurs
-/// - calls the callback on error (using an event handler)
+/// - calls the callback on error
+/// Unlike event handlers, errors may be reported from any thread (e.g. while constructing the loop).
 /// @note The default constructor initializes the callback to print the error message to std::cerr.
 class ErrorHandler {
     public:
@@ -42,7 +43,8 @@ class ErrorHandler {
 	/// @param error Error event.
 	void handle(Error &&error)
 	{
-		handler.handle(std::move(error));
+		if (error_callback)
+			error_callback(std::move(error));
 	}
 
 	/// @brief Override to directly take an error message instead of an error object. The object is constructed from
@@ -50,7 +52,7 @@ class ErrorHandler {
 	/// @param message Error message.
 	void handle(std::string_view message)
 	{
-		handler.handle(Error(message));
+		handle(Error(message));
 	}
 
 	/// @brief Set a new callback to handle the error event, replacing the current one.
@@ -60,11 +62,11 @@ class ErrorHandler {
 	template <class Func>
 	void onError(Func &&callback)
 	{
-		handler.on<Error>(std::move(callback));
+		error_callback = InlineCallback<void(Error &&)>{ std::forward<Func>(callback) };
 	}
 
     private:
-	EventHandler<Error> handler{};
+	InlineCallback<void(Error &&)> error_callback{};
 };
 
 } // namespace ringnet
\ No newline at end of file
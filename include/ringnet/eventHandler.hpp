@@ -1,9 +1,10 @@
 #pragma once
 
-#include <functional>
-#include <mutex>
 #include <tuple>
+#include <utility>
 
+#include "ringnet/inlineCallback.hpp"
+#include "ringnet/threadAffinity.hpp"
 #include "ringnet/traits/movable.hpp"
 
 namespace ringnet
@@ -11,34 +12,37 @@ namespace ringnet
 /// @brief Do not move an EventHandler: its address is associated to requests submitted to the kernel, in order to
 /// invoke one of its handlers on request completion. Hence, the address must remain untouched between submission and
 /// completion.
+/// An EventHandler is single-threaded: events are handled on the thread running its loop, which also has to be the one
+/// replacing callbacks once the first event was handled (checked in debug builds).
 template <class... Events>
 class EventHandler : public traits::NonMovable {
 	template <class Event>
-
-	using Callback = std::function<void(Event &&)>;
+	using Callback = InlineCallback<void(Event &&)>;
 
     public:
 	EventHandler() = default;
 
 	template <class Event>
-	auto handle(Event &&data) noexcept
+	void handle(Event &&data) noexcept
 	{
-		std::lock_guard<std::mutex> lock{ mutex };
-		const auto &handler_ = handler<Event>();
+		affinity.check();
+		auto &handler_ = handler<Event>();
 		if (handler_)
-			return handler_(std::move(data));
+			handler_(std::move(data));
 	}
 
-	template <typename Event>
-	void on(Callback<Event> f)
+	/// @brief Set the callback of an event type, replacing the current one.
+	/// @note The callable is stored inline: its size is checked at compile time against INLINE_CALLBACK_CAPACITY.
+	template <typename Event, class Func>
+	void on(Func &&f)
 	{
-		std::lock_guard<std::mutex> lock{ mutex };
-		handler<Event>() = std::move(f);
+		affinity.checkIfOwned();
+		handler<Event>() = Callback<Event>{ std::forward<Func>(f) };
 	}
 
     private:
 	std::tuple<Callback<Events>...> handlers{};
-	std::mutex mutex{};
+	[[no_unique_address]] ThreadAffinity affinity{};
 
 	template <class Event>
 	Callback<Event> &handler() noexcept
@@ -46,4 +50,4 @@ class EventHandler : public traits::NonMovable {
 		return std::get<Callback<Event>>(handlers);
 	}
 };
-} // namespace ringnet
\ No newline at end of file
+} // namespace ringnet
@@ -2,13 +2,27 @@
 
 #include <array>
 #include <atomic>
+#include <chrono>
+#include <concepts>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
 
+#include "ringnet/batchingPolicy.hpp"
+#include "ringnet/completionSink.hpp"
+#include "ringnet/coro/framePool.hpp"
+#include "ringnet/coro/task.hpp"
 #include "ringnet/errorHandler.hpp"
 #include "ringnet/eventHandler.hpp"
 #include "ringnet/events.hpp"
+#include "ringnet/idleStrategy.hpp"
 #include "ringnet/status.hpp"
+#include "ringnet/time/timerWheel.hpp"
 #include "ringnet/uring/bufferRing.hpp"
 #include "ringnet/uring/requests.hpp"
+#include "ringnet/uring/ringConfig.hpp"
 #include "ringnet/uring/submissionQueue.hpp"
 
 namespace ringnet
@@ -18,12 +32,60 @@ using Subscriber = EventHandler<events::ErrorEvent, events::AcceptEvent, events:
 				events::ConnectEvent>;
 class EventLoop {
     public:
-	EventLoop(size_t request_queue_size);
+	/// @brief Counters updated by the loop while running. Read them from the loop thread (e.g. from a handler), or
+	/// once the loop is stopped.
+	struct Statistics {
+		uint64_t iterations = 0;
+		/// @brief Completions dispatched to subscribers, sinks or the loop itself.
+		uint64_t completions = 0;
+		/// @brief Iterations that found completions held back by the kernel, the completion queue being full.
+		/// If frequent, consider a larger completion queue (RingConfig::completion_queue_size).
+		uint64_t completion_queue_overflows = 0;
+		/// @brief Submissions to the kernel, and entries they carried.
+		uint64_t submissions = 0;
+		uint64_t submitted_entries = 0;
+		/// @brief Multi-shot requests (accept, read) armed in the kernel, as of the last submission.
+		size_t active_multishots = 0;
+
+		double averageBatchSize() const
+		{
+			if (!submissions)
+				return 0.;
+			return static_cast<double>(submitted_entries) / static_cast<double>(submissions);
+		}
+		/// @brief Time spent waiting for completions, either blocked in the kernel or polling from user space.
+		std::chrono::nanoseconds idle_time{};
+	};
+
+	/// @param request_queue_size Size of the io_uring submission queue.
+	/// @param ring_config io_uring setup options (e.g. kernel-side submission polling).
+	EventLoop(size_t request_queue_size, const uring::RingConfig &ring_config = {});
 	~EventLoop();
 
+	EventLoop(const EventLoop &) = delete;
+	EventLoop &operator=(const EventLoop &) = delete;
+
 	void run();
+
+	/// @brief Stop the loop, waking it up if it is idle.
+	/// @note Thread-safe.
 	void stop();
 
+	/// @brief Select what the loop does when it has nothing to process. Defaults to IdleStrategy::block().
+	void setIdleStrategy(const IdleStrategy &strategy);
+
+	/// @brief Select when prepared requests are submitted. Defaults to BatchingPolicy::immediate().
+	void setBatchingPolicy(const BatchingPolicy &policy);
+
+	/// @brief Cap the number of completions handled per iteration (defaults to DEFAULT_COMPLETION_BUDGET). Past
+	/// the budget, the loop submits the requests queued so far (e.g. writes answering the handled reads) and runs
+	/// posted tasks and timers, before handling the remaining completions.
+	void setCompletionBudget(size_t budget);
+
+	static constexpr size_t DEFAULT_COMPLETION_BUDGET = 256;
+
+	const Statistics &statistics() const;
+
 	template <class Func>
 	void onError(Func &&callback);
 
@@ -35,20 +97,168 @@ class EventLoop {
 	/// @tparam Request Type of the request
 	/// @param request Content of the request
 	/// @param subscriber Notified subscriber
-	/// @return Cf. enumerate
+	/// @return QUEUE_FULL if too many requests of this type are already in flight (as many as the completion queue
+	/// size), OK otherwise.
 	/// @warning The duration of both the request and the subscriber must outlive the completion.
 	template <class Request>
 	uring::AddRequestStatus add(Request &&request, Subscriber *subscriber);
 
+	/// @brief Add a request whose completion is notified to the given sink, right from the completion dispatch.
+	/// @warning The sink must outlive the completion, or detach the request beforehand.
+	template <class Request>
+	uring::AddRequestStatus add(Request &&request, CompletionSink *sink);
+
+	/// @brief Same as add, but hand back the header of the pooled request, valid until its completion is notified:
+	/// lets a sink going away first detach the request.
+	/// @return Null if the request could not be queued.
+	template <class Request>
+	uring::RequestHeader *push(Request &&request, CompletionSink *sink);
+
+	/// @brief Stop notifying the completion of the request: it only releases its resources (e.g. provided
+	/// buffers). Used by the sinks, or subscribers, destroyed before the completion of their request.
+	/// @warning Call from the loop thread.
+	static void detach(uring::RequestHeader &header);
+
+	/// @brief Start a coroutine, detached from the caller: it runs until its first suspension, then is resumed on
+	/// the loop thread by the completions it awaits. Its frame is freed once completed. An exception escaping the
+	/// coroutine is reported to the error handler.
+	void spawn(coro::Task<void> task);
+
+	/// @brief Create the coroutine by invoking the given factory (e.g. a lambda calling a coroutine function), with
+	/// the loop's frame pool made current: unlike a coroutine created outside of the loop, its frame is pooled.
+	template <class Factory>
+		requires std::invocable<Factory>
+	void spawn(Factory &&factory);
+
 	void cancel(int socket_fd);
 
+	/// @brief Cancel the in-flight requests on the socket, then close it once they are cancelled: closed right
+	/// away, the socket would no longer match them, or match another socket reusing its number. Takes ownership
+	/// of the file descriptor.
+	void closeFile(int socket_fd);
+
+	/// @brief Cancel the in-flight requests on the socket installed at this slot of the fixed-file table, then free
+	/// the slot (closing the socket).
+	void closeFixedFile(int index);
+
+	/// @brief Number of size classes of provided buffers: one per group of RingConfig::provided_buffers.
+	size_t bufferClassesCount() const;
+
+	/// @brief Size of the provided buffers of the class.
+	size_t bufferSize(size_t size_class) const;
+
+	/// @brief Buffer group ID of the size class, for read requests.
+	uint16_t bufferGroupId(size_t size_class) const;
+
+	/// @brief Move the multi-shot reads armed on the socket to the provided buffers of another size class: they are
+	/// cancelled, then armed again, without notifying the cancellation.
+	/// @param flags Flags of the requests on the socket (FIXED_FILE).
+	/// @warning Call from the loop thread.
+	void switchBufferClass(int socket_fd, uint8_t flags, size_t size_class);
+
+	/// @brief Whether the provided buffers of the class are consumed incrementally (RingConfig::provided_buffers):
+	/// requires Linux 6.12.
+	bool incrementalBuffers(size_t size_class = 0) const;
+
+	/// @brief Whether the kernel supports receive bundles (Connection::asyncReadBundles).
+	bool supportsReceiveBundles() const;
+
+	/// @brief Number of slots of the fixed-file table of the ring (RingConfig::fixed_files).
+	uint32_t fixedFilesCount() const;
+
+	/// @brief Lease a send buffer registered with the ring (RingConfig::send_buffers), to be filled then written
+	/// (Connection::asyncWrite). It goes back to the pool once written, or if dropped.
+	/// @return The leased buffer, or an empty one if all are in use (or none is registered).
+	/// @warning Call from the loop thread.
+	uring::SendBuffer leaseSendBuffer();
+
+	/// @brief Schedule the timer to expire after the given delay, rounded up to the timer wheel resolution (1 ms).
+	/// Reschedule it if already scheduled. Its callback is invoked on the loop thread, at the end of an iteration.
+	/// @warning Call from the loop thread. The timer must not be moved while scheduled.
+	void schedule(time::Timer &timer, std::chrono::nanoseconds delay);
+
+	/// @brief Cancel the timer, if scheduled.
+	void cancel(time::Timer &timer);
+
+	/// @brief Flush the sink right before the next submission, unless already scheduled.
+	/// @warning Call from the loop thread. The sink must outlive the flush, or cancel it.
+	void scheduleFlush(FlushSink &sink);
+
+	/// @brief Cancel the flush of the sink, if scheduled.
+	void cancelFlush(FlushSink &sink);
+
+	/// @brief Run a task on the loop thread, during the next iteration. Posted tasks are run in order, once the
+	/// iteration's completions are handled. The loop is woken up right away if idle (through an event file
+	/// descriptor).
+	/// @note Thread-safe: typically used by worker threads to hand back results (e.g. a write request to add).
+	template <class Task>
+	void post(Task &&task);
+
+	/// @brief Run a task on the target loop thread, during its next iteration. The target loop is woken up by a
+	/// message sent from this loop's ring to the target's ring (IORING_OP_MSG_RING), within this loop's next
+	/// submission. Falls back to the target's event file descriptor if the message cannot be delivered.
+	/// @warning Call from this loop's thread (e.g. from a handler, or a posted task).
+	template <class Task>
+	void postTo(EventLoop &target, Task &&task);
+
     private:
 	ringnet::uring::SubmissionQueue submission_queue;
-	using Buffer = std::array<std::byte, 1024>;
-	std::array<Buffer, 2048> buffers{};
-	ringnet::uring::BufferRing<Buffer> buffer_ring;
+	/// @brief Group of provided buffers (RingConfig::provided_buffers), carved out of a single allocation.
+	using Buffer = std::span<std::byte>;
+	struct BufferGroup {
+		std::unique_ptr<std::byte[]> memory;
+		std::vector<Buffer> buffers{};
+		ringnet::uring::BufferRing<Buffer> ring;
+
+		BufferGroup(io_uring &io_ring, uint16_t group_id, const uring::ProvidedBuffers &config);
+	};
+	/// @brief By size class: the group ID of a class is its index plus one.
+	std::vector<std::unique_ptr<BufferGroup>> buffer_groups{};
 	std::atomic_bool should_continue{ true };
 
+	IdleStrategy idle_strategy{};
+	size_t completion_budget = DEFAULT_COMPLETION_BUDGET;
+	Statistics statistics_{};
+
+	using PostedTask = std::function<void()>;
+	std::mutex posted_tasks_mutex{};
+	std::vector<PostedTask> posted_tasks{};
+	/// @brief Tasks being run, swapped with the posted ones at each iteration (both keep their capacity).
+	std::vector<PostedTask> running_tasks{};
+
+	std::vector<FlushSink *> scheduled_flushes{};
+	/// @brief Sinks being flushed, swapped with the scheduled ones: a flush may schedule the next one.
+	std::vector<FlushSink *> running_flushes{};
+	void runFlushes();
+
+	/// @brief Set once a wakeup is on its way, until the tasks are drained: coalesces the wakeups of a burst of
+	/// posts.
+	std::atomic_bool wakeup_pending{ false };
+	int wakeup_fd = -1;
+	uint64_t wakeup_counter = 0;
+	Subscriber wakeup_subscriber{};
+
+	/// @brief Push a task, without waking the loop up.
+	/// @return Whether the loop needs to be woken up (no wakeup is pending yet).
+	template <class Task>
+	bool enqueue(Task &&task);
+
+	/// @brief Keep a read request armed on the event file descriptor: writing to it completes the read, which
+	/// wakes the loop up.
+	void armWakeup();
+	/// @brief Wake the loop up through its event file descriptor.
+	void signal();
+	void runPostedTasks();
+
+	using Clock = std::chrono::steady_clock;
+
+	/// @brief Submit pending requests, then idle according to the idle strategy if no completion is available.
+	uring::SubmitStatus submitThenIdle();
+
+	/// @brief Poll the completion queue from user space, up to the given duration.
+	/// @return Whether a completion is available.
+	bool spin(std::chrono::nanoseconds duration);
+
 	using Completion = const io_uring_cqe *;
 
 	template <class Request>
@@ -56,6 +266,53 @@ class EventLoop {
 
 	inline static Subscriber *getAssociatedSubscriber(const uring::RequestHeader *header);
 
+	/// @brief Notify either the subscriber or the completion sink of the request.
+	template <class Event>
+	void notify(uring::UserData user_data, Event &&event);
+
+	template <class Request>
+	uring::RequestHeader *push(Request &&request, void *target, uint8_t flags);
+
+	/// @brief Frames of the coroutines created on the loop thread, while running.
+	coro::FramePool frame_pool{};
+
+	coro::Detached runDetached(coro::Task<void> task);
+
+	time::TimerWheel timers{};
+	/// @brief In-flight timeout request, waking the loop up at the next deadline of the timer wheel.
+	uring::TimeoutRequest *armed_timeout = nullptr;
+	Clock::time_point armed_deadline{};
+
+	/// @brief Run the expired timers, then make sure a timeout is armed for the next deadline (at most one timeout
+	/// request per iteration).
+	void runTimers();
+
+	/// @brief Notify the subscriber of the bytes read into a provided buffer, then give the buffer back to the
+	/// ring.
+	void handleProvidedBufferRead(Completion cqe, int fd, uring::UserData user_data);
+
+	/// @brief Notify the subscriber of a zero-copy send once the kernel is done with the bytes: on the
+	/// notification, or on the result if no notification follows.
+	void handleZeroCopySend(Completion cqe, uring::UserData user_data);
+
+	/// @brief Notify the subscriber of the bytes read into a bundle of provided buffers, then give them back to the
+	/// ring.
+	void handleBundleRead(Completion cqe, int fd, uring::UserData user_data);
+	/// @brief Views of the buffers of the bundle being notified.
+	std::vector<std::span<const std::byte>> bundle_views{};
+
+	/// @return The buffer ring the read request selects its buffers from, null for other requests.
+	ringnet::uring::BufferRing<Buffer> *providedBuffers(uring::UserData user_data);
+
+	static bool isMultishot(uring::UserData user_data);
+
+	/// @brief Whether the request was submitted with a linked timeout.
+	static bool hasDeadline(uring::UserData user_data);
+
+	/// @brief Handle the completions of the requests issued by the loop itself, rather than by a subscriber.
+	/// @return Whether the completion was handled.
+	bool handleInternalCompletion(Completion cqe, uring::UserData user_data);
+
 	ErrorHandler error_handler{};
 
 	template <class Stream = std::ostream>
@@ -77,29 +334,114 @@ Resource EventLoop::resource(Args &&...args)
 template <class Request>
 inline Request *EventLoop::getIssuingRequest(Completion cqe)
 {
-	return reinterpret_cast<Request *>(cqe->user_data);
+	return uring::UserData{ cqe->user_data }.request<Request>();
+}
+
+inline Subscriber *EventLoop::getAssociatedSubscriber(const uring::RequestHeader *header)
+{
+	return static_cast<Subscriber *>(header->user_data);
 }
 
 template <class Request>
 uring::AddRequestStatus EventLoop::add(Request &&request, Subscriber *subscriber)
 {
-	if constexpr (std::is_same_v<std::decay_t<Request>, uring::MultiShotReadRequest>)
-		request.buffer_group_id = buffer_ring.BUFFER_GROUP_ID;
+	if (!push(std::forward<Request>(request), static_cast<void *>(subscriber), 0))
+		return uring::AddRequestStatus::QUEUE_FULL;
+	return uring::AddRequestStatus::OK;
+}
 
-	request.header.user_data = static_cast<void *>(subscriber);
-	submission_queue.push(std::move(request));
+template <class Request>
+uring::AddRequestStatus EventLoop::add(Request &&request, CompletionSink *sink)
+{
+	if (!push(std::forward<Request>(request), sink))
+		return uring::AddRequestStatus::QUEUE_FULL;
 	return uring::AddRequestStatus::OK;
 }
 
+template <class Request>
+uring::RequestHeader *EventLoop::push(Request &&request, CompletionSink *sink)
+{
+	return push(std::forward<Request>(request), static_cast<void *>(sink), uring::NOTIFY_SINK);
+}
+
+inline void EventLoop::detach(uring::RequestHeader &header)
+{
+	header.user_data = nullptr;
+}
+
+template <class Request>
+uring::RequestHeader *EventLoop::push(Request &&request, void *target, uint8_t flags)
+{
+	if constexpr (std::is_same_v<std::decay_t<Request>, uring::MultiShotReadRequest> ||
+		      std::is_same_v<std::decay_t<Request>, uring::BundleReadRequest> ||
+		      std::is_same_v<std::decay_t<Request>, uring::ProvidedBufferReadRequest>) {
+		if (request.buffer_group_id == uring::NO_BUFFER_GROUP)
+			request.buffer_group_id = bufferGroupId(0);
+	}
+
+	request.header.user_data = target;
+	request.header.flags |= flags;
+	auto *pooled = submission_queue.push(std::move(request));
+	return pooled ? &pooled->header : nullptr;
+}
+
+template <class Event>
+void EventLoop::notify(uring::UserData user_data, Event &&event)
+{
+	const uring::RequestHeader *header = user_data.header();
+	if (user_data.has(uring::NOTIFY_SINK)) {
+		CompletionSink *sink = static_cast<CompletionSink *>(header->user_data);
+		sink->notify(*sink, std::forward<Event>(event));
+	} else
+		getAssociatedSubscriber(header)->handle(std::forward<Event>(event));
+}
+
+template <class Factory>
+	requires std::invocable<Factory>
+void EventLoop::spawn(Factory &&factory)
+{
+	coro::FramePool::Scope frame_scope{ frame_pool };
+	spawn(std::invoke(std::forward<Factory>(factory)));
+}
+
+template <class Task>
+bool EventLoop::enqueue(Task &&task)
+{
+	{
+		std::lock_guard<std::mutex> lock{ posted_tasks_mutex };
+		posted_tasks.emplace_back(std::forward<Task>(task));
+	}
+	return !wakeup_pending.exchange(true);
+}
+
+template <class Task>
+void EventLoop::post(Task &&task)
+{
+	if (enqueue(std::forward<Task>(task)))
+		signal();
+}
+
+template <class Task>
+void EventLoop::postTo(EventLoop &target, Task &&task)
+{
+	if (!target.enqueue(std::forward<Task>(task)))
+		return;
+
+	uring::MessageRequest request{ .target_ring_fd = target.submission_queue.getRing().ring_fd,
+				       .data = uring::UserData::of(uring::Operation::WAKEUP).value };
+	request.header.user_data = static_cast<void *>(&target);
+	request.header.flags = uring::URGENT;
+	if (!submission_queue.push(std::move(request)))
+		target.signal();
+}
+
 template <class Stream>
 void EventLoop::logIssuingRequest(Completion cqe, Stream &stream)
 {
 	using namespace ringnet::uring;
-	uring::RequestHeader *header = reinterpret_cast<uring::RequestHeader *>(cqe->user_data);
-
 	stream << "During handling of ";
 
-	switch (header->op) {
+	switch (UserData{ cqe->user_data }.op()) {
 	case Operation::ACCEPT: {
 		stream << *getIssuingRequest<uring::AcceptRequest>(cqe);
 	} break;
@@ -109,12 +451,36 @@ void EventLoop::logIssuingRequest(Completion cqe, Stream &stream)
 	case Operation::READ_MULTISHOT: {
 		stream << *getIssuingRequest<uring::MultiShotReadRequest>(cqe);
 	} break;
+	case Operation::READ_BUNDLE: {
+		stream << *getIssuingRequest<uring::BundleReadRequest>(cqe);
+	} break;
+	case Operation::READ_PROVIDED_BUFFER: {
+		stream << *getIssuingRequest<uring::ProvidedBufferReadRequest>(cqe);
+	} break;
 	case Operation::WRITE: {
 		stream << *getIssuingRequest<uring::WriteRequest>(cqe);
 	} break;
+	case Operation::WRITE_FIXED: {
+		stream << *getIssuingRequest<uring::WriteFixedRequest>(cqe);
+	} break;
+	case Operation::WRITEV: {
+		stream << *getIssuingRequest<uring::WritevRequest>(cqe);
+	} break;
+	case Operation::SEND_ZERO_COPY: {
+		stream << *getIssuingRequest<uring::SendZeroCopyRequest>(cqe);
+	} break;
 	case Operation::CONNECT: {
 		stream << *getIssuingRequest<uring::ConnectRequest>(cqe);
 	} break;
+	case Operation::MESSAGE: {
+		stream << *getIssuingRequest<uring::MessageRequest>(cqe);
+	} break;
+	case Operation::TIMEOUT: {
+		stream << *getIssuingRequest<uring::TimeoutRequest>(cqe);
+	} break;
+	case Operation::TIMEOUT_UPDATE: {
+		stream << *getIssuingRequest<uring::TimeoutUpdateRequest>(cqe);
+	} break;
 	default:
 		stream << "malformed completion queue entry" << std::endl;
 		break;
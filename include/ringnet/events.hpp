@@ -2,6 +2,7 @@
 
 #include <functional>
 #include <span>
+#include <sys/uio.h>
 #include <tuple>
 
 #include "string.h"
@@ -22,6 +23,9 @@ struct ErrorEvent {
 
 struct AcceptEvent {
 	int client_fd{};
+	/// @brief The client socket was accepted directly into the fixed-file table of the loop: client_fd is its slot
+	/// index, not a file descriptor.
+	bool fixed_file = false;
 };
 
 struct ConnectEvent {};
@@ -29,10 +33,17 @@ struct ConnectEvent {};
 struct ReadEvent {
 	int fd{};
 	std::span<const std::byte> bytes_read{};
+	/// @brief Bundled reads only: the bytes read, spread over consecutive buffers. bytes_read then views the first
+	/// one.
+	std::span<const std::span<const std::byte>> buffers{};
 };
 
 struct WriteEvent {
 	int fd{};
 	std::span<const std::byte> bytes_written{};
+	/// @brief Vectored writes only: the submitted buffers. bytes_written is then empty, and vectored_size holds the
+	/// number of bytes written across the buffers (a short write may stop within any of them).
+	std::span<const iovec> buffers{};
+	size_t vectored_size = 0;
 };
 } // namespace ringnet::events
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <chrono>
+
+namespace ringnet
+{
+
+/// @brief What an event loop does once it has nothing left to process: no completion is available.
+/// - BLOCK: wait in the kernel for a completion (io_uring_wait_cqe_timeout), up to block_timeout. Frees the core, at
+/// the cost of a wakeup latency.
+/// - SPIN_THEN_BLOCK: poll the completion queue from user space for spin_duration, then block as above. Catches
+/// completions arriving shortly after going idle, without burning a core when the loop is idle for long.
+/// - BUSY_POLL: never block: poll the completion queue for spin_duration (possibly zero, i.e. a single check), then
+/// start a new iteration. Lowest latency, burns a core.
+struct IdleStrategy {
+	enum class Mode { BLOCK = 0, SPIN_THEN_BLOCK = 1, BUSY_POLL = 2 };
+
+	static constexpr std::chrono::milliseconds DEFAULT_BLOCK_TIMEOUT{ 100 };
+
+	Mode mode = Mode::BLOCK;
+	std::chrono::microseconds spin_duration{ 0 };
+	/// @brief Upper bound of a single blocking wait. The loop checks whether it was stopped at least that often.
+	std::chrono::milliseconds block_timeout{ DEFAULT_BLOCK_TIMEOUT };
+
+	static constexpr IdleStrategy block(std::chrono::milliseconds timeout = DEFAULT_BLOCK_TIMEOUT)
+	{
+		return IdleStrategy{ .mode = Mode::BLOCK, .spin_duration = {}, .block_timeout = timeout };
+	}
+
+	static constexpr IdleStrategy spinThenBlock(std::chrono::microseconds spin,
+						    std::chrono::milliseconds timeout = DEFAULT_BLOCK_TIMEOUT)
+	{
+		return IdleStrategy{ .mode = Mode::SPIN_THEN_BLOCK, .spin_duration = spin, .block_timeout = timeout };
+	}
+
+	static constexpr IdleStrategy busyPoll(std::chrono::microseconds spin = {})
+	{
+		return IdleStrategy{ .mode = Mode::BUSY_POLL, .spin_duration = spin, .block_timeout = {} };
+	}
+};
+
+} // namespace ringnet
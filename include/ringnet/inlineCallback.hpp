@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace ringnet
+{
+
+/// @brief Default inline storage of a callback: room for a handful of captured pointers (or a nested callback).
+inline constexpr size_t INLINE_CALLBACK_CAPACITY = 64;
+
+template <class Signature, size_t Capacity = INLINE_CALLBACK_CAPACITY>
+class InlineCallback;
+
+/// @brief Move-only replacement of std::function, storing the callable in place: it never allocates, and calling it
+/// costs a single indirect call. A callable too large to fit is rejected at compile time, rather than silently moved to
+/// the heap.
+template <class Result, class... Args, size_t Capacity>
+class InlineCallback<Result(Args...), Capacity> {
+    public:
+	InlineCallback() = default;
+
+	template <class Func>
+		requires(!std::is_same_v<std::decay_t<Func>, InlineCallback> &&
+			 std::is_invocable_r_v<Result, Func &, Args...>)
+	InlineCallback(Func &&callable)
+	{
+		emplace(std::forward<Func>(callable));
+	}
+
+	InlineCallback(InlineCallback &&other) noexcept
+	{
+		moveFrom(other);
+	}
+
+	InlineCallback &operator=(InlineCallback &&other) noexcept
+	{
+		if (this != &other) {
+			reset();
+			moveFrom(other);
+		}
+		return *this;
+	}
+
+	InlineCallback(const InlineCallback &) = delete;
+	InlineCallback &operator=(const InlineCallback &) = delete;
+
+	~InlineCallback()
+	{
+		reset();
+	}
+
+	explicit operator bool() const noexcept
+	{
+		return invoke != nullptr;
+	}
+
+	Result operator()(Args... args)
+	{
+		return invoke(storage, std::forward<Args>(args)...);
+	}
+
+	/// @brief Destroy the stored callable, if any.
+	void reset() noexcept
+	{
+		if (manage)
+			manage(Action::DESTROY, storage, nullptr);
+		invoke = nullptr;
+		manage = nullptr;
+	}
+
+    private:
+	enum class Action { MOVE, DESTROY };
+	using Invoke = Result (*)(void *, Args &&...);
+	/// @brief Move the callable to the destination storage (then destroy the source), or destroy it.
+	using Manage = void (*)(Action, void *source, void *destination) noexcept;
+
+	alignas(std::max_align_t) std::byte storage[Capacity]{};
+	Invoke invoke = nullptr;
+	Manage manage = nullptr;
+
+	template <class Func>
+	void emplace(Func &&callable)
+	{
+		using Stored = std::decay_t<Func>;
+		static_assert(sizeof(Stored) <= Capacity,
+			      "Callable too large for inline storage: capture fewer objects, or by reference");
+		static_assert(alignof(Stored) <= alignof(std::max_align_t), "Over-aligned callables are not supported");
+		static_assert(std::is_nothrow_move_constructible_v<Stored>, "Callables must be nothrow movable");
+
+		::new (static_cast<void *>(storage)) Stored(std::forward<Func>(callable));
+		invoke = [](void *self, Args &&...args) -> Result {
+			return std::invoke(*static_cast<Stored *>(self), std::forward<Args>(args)...);
+		};
+		manage = [](Action action, void *source, void *destination) noexcept {
+			Stored *stored = static_cast<Stored *>(source);
+			if (action == Action::MOVE)
+				::new (destination) Stored(std::move(*stored));
+			stored->~Stored();
+		};
+	}
+
+	void moveFrom(InlineCallback &other) noexcept
+	{
+		if (!other.invoke)
+			return;
+		other.manage(Action::MOVE, other.storage, storage);
+		invoke = std::exchange(other.invoke, nullptr);
+		manage = std::exchange(other.manage, nullptr);
+	}
+};
+
+} // namespace ringnet
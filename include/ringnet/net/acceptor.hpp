@@ -1,8 +1,13 @@
 #pragma once
 
 #include <atomic>
+#include <coroutine>
+#include <deque>
 #include <limits>
 
+#include <tl/expected.hpp>
+
+#include "ringnet/completionSink.hpp"
 #include "ringnet/eventLoop.hpp"
 #include "ringnet/net/connection.hpp"
 #include "ringnet/net/sockets.hpp"
@@ -20,6 +25,19 @@ class Acceptor {
     public:
 	enum class Status { NOT_LISTENING = 0, LISTENING = 1 };
 
+	/// @brief EXCLUSIVE: the listening socket is the only one bound to its address.
+	/// REUSE_PORT: the listening socket is opened with SO_REUSEPORT, so that several acceptors (typically one per
+	/// shard of a ShardedEventLoop) listen to the same address. The kernel then spreads incoming connections among
+	/// them, and each connection is handled by the loop of the acceptor which accepted it.
+	enum class ListeningMode { EXCLUSIVE = 0, REUSE_PORT = 1 };
+
+	/// @brief FILE_DESCRIPTOR: accepted sockets get a file descriptor, as with accept(2).
+	/// DIRECT: accepted sockets are installed straight into free slots of the fixed-file table of the loop
+	/// (io_uring_prep_multishot_accept_direct), which must have been registered (RingConfig::fixed_files). Their
+	/// connections then skip the file lookup on every request, but cannot be used outside of the loop. Once the
+	/// table is full, accepting fails with ENFILE.
+	enum class AcceptMode { FILE_DESCRIPTOR = 0, DIRECT = 1 };
+
 	explicit Acceptor(ringnet::EventLoop &loop, size_t max_connections = std::numeric_limits<size_t>::max());
 
 	~Acceptor();
@@ -38,13 +56,41 @@ class Acceptor {
 	/// the acceptance callback.
 	/// @param listening_address (Local) address to listen to.
 	/// @param listening_port Port to listen to.
+	/// @param mode Whether the listening address is shared with other acceptors.
+	/// @param accept_mode Whether accepted sockets go to the fixed-file table of the loop.
 	/// @return An error if setting up the multi-shot accept request failed. Success otherwise.
-	MessagedStatus listen(std::string_view listening_address, uint16_t listening_port);
+	MessagedStatus listen(std::string_view listening_address, uint16_t listening_port,
+			      ListeningMode mode = ListeningMode::EXCLUSIVE,
+			      AcceptMode accept_mode = AcceptMode::FILE_DESCRIPTOR);
+
+	class NextConnection;
+
+	/// @brief Await the next accepted connection (C++20 coroutines), as an asynchronous stream:
+	/// `while (auto connection = co_await acceptor.next()) {...}`. The awaiting coroutine is resumed directly on
+	/// completion. From the first call on, connections accepted while no coroutine awaits are queued, rather
+	/// than passed to the onNewConnection callback.
+	[[nodiscard]] NextConnection next();
 
     private:
 	ringnet::EventLoop &loop;
 	std::unique_ptr<ringnet::Subscriber> subscriber = std::make_unique<ringnet::Subscriber>();
 
+	/// @brief Receives the completions of the multi-shot accept request. Forwards them to the subscriber, until a
+	/// coroutine awaits the next connection: from then on, they are queued for, or handed to, the awaiting
+	/// coroutine.
+	struct AcceptSink : CompletionSink {
+		ringnet::Subscriber *subscriber = nullptr;
+		bool streaming = false;
+		std::deque<tl::expected<events::AcceptEvent, events::ErrorEvent>> accepted{};
+		std::coroutine_handle<> awaiting{};
+
+		static void deliver(CompletionSink &sink, Event &&event);
+	};
+	std::unique_ptr<AcceptSink> accept_sink = std::make_unique<AcceptSink>();
+
+	/// @brief Wrap the accepted socket, either a file descriptor or a slot of the fixed-file table.
+	Connection makeConnection(const events::AcceptEvent &event);
+
 	std::atomic<Status> status = Status::NOT_LISTENING;
 	size_t max_connections;
 
@@ -52,16 +98,75 @@ class Acceptor {
 	FileDescriptor listening_socket{};
 };
 
+template <DatagramProtocol DP>
+class Acceptor<DP>::NextConnection {
+    public:
+	explicit NextConnection(Acceptor &acceptor_) : acceptor(acceptor_)
+	{
+	}
+
+	bool await_ready() const noexcept
+	{
+		return !acceptor.accept_sink->accepted.empty();
+	}
+
+	void await_suspend(std::coroutine_handle<> continuation) const noexcept
+	{
+		acceptor.accept_sink->awaiting = continuation;
+	}
+
+	tl::expected<Connection, events::ErrorEvent> await_resume() const
+	{
+		auto &accepted = acceptor.accept_sink->accepted;
+		tl::expected<events::AcceptEvent, events::ErrorEvent> event = accepted.front();
+		accepted.pop_front();
+		if (!event)
+			return tl::unexpected(event.error());
+		return acceptor.makeConnection(event.value());
+	}
+
+    private:
+	Acceptor &acceptor;
+};
+
 template <DatagramProtocol DP>
 Acceptor<DP>::Acceptor(EventLoop &loop_, size_t max_connections_) : loop(loop_), max_connections(max_connections_)
 {
+	accept_sink->notify = &AcceptSink::deliver;
+	accept_sink->subscriber = subscriber.get();
+}
+
+template <DatagramProtocol DP>
+void Acceptor<DP>::AcceptSink::deliver(CompletionSink &sink, Event &&event)
+{
+	AcceptSink &self = static_cast<AcceptSink &>(sink);
+	if (!self.streaming) {
+		std::visit([&self](auto &&event_) { self.subscriber->handle(std::move(event_)); }, std::move(event));
+		return;
+	}
+
+	if (const events::ErrorEvent *error = std::get_if<events::ErrorEvent>(&event))
+		self.accepted.push_back(tl::unexpected(*error));
+	else if (const events::AcceptEvent *accepted = std::get_if<events::AcceptEvent>(&event))
+		self.accepted.push_back(*accepted);
+
+	if (self.awaiting)
+		std::exchange(self.awaiting, nullptr).resume();
+}
+
+template <DatagramProtocol DP>
+typename Acceptor<DP>::NextConnection Acceptor<DP>::next()
+{
+	// From now on, accepted connections are queued for the awaiting coroutines.
+	accept_sink->streaming = true;
+	return NextConnection{ *this };
 }
 
 template <DatagramProtocol DP>
 Acceptor<DP>::~Acceptor()
 {
 	if (listening_socket)
-		loop.cancel(listening_socket.fd);
+		loop.closeFile(listening_socket.release());
 }
 
 template <DatagramProtocol DP>
@@ -76,16 +181,28 @@ template <class Func>
 void Acceptor<DP>::onNewConnection(Func user_callback)
 {
 	subscriber->on<ringnet::events::AcceptEvent>([this, user_callback](const ringnet::events::AcceptEvent &event) {
-		user_callback(Connection{ loop, FileDescriptor{ event.client_fd } });
+		user_callback(makeConnection(event));
 	});
 }
 
 template <DatagramProtocol DP>
-MessagedStatus Acceptor<DP>::listen(std::string_view listening_address, uint16_t listening_port)
+Connection Acceptor<DP>::makeConnection(const events::AcceptEvent &event)
+{
+	if (event.fixed_file)
+		return Connection{ loop, net::FixedFile{ event.client_fd } };
+	return Connection{ loop, FileDescriptor{ event.client_fd } };
+}
+
+template <DatagramProtocol DP>
+MessagedStatus Acceptor<DP>::listen(std::string_view listening_address, uint16_t listening_port, ListeningMode mode,
+				    AcceptMode accept_mode)
 {
 	if (status == Status::LISTENING)
 		return MessagedStatus{ false, "Already listening" };
 
+	if (accept_mode == AcceptMode::DIRECT && loop.fixedFilesCount() == 0)
+		return MessagedStatus{ false, "Accepting directly requires a fixed-file table" };
+
 	const auto resolved_address = ringnet::net::resolve(listening_address, listening_port, DP, true);
 	if (!resolved_address)
 		return MessagedStatus{ false, "Error resolving address " + std::string(listening_address) + ":" +
@@ -101,6 +218,15 @@ MessagedStatus Acceptor<DP>::listen(std::string_view listening_address, uint16_t
 						      std::string(listening_address) + ":" +
 						      std::to_string(listening_port) + ": " + socket_status.what() };
 
+	if (mode == ListeningMode::REUSE_PORT) {
+		socket_status = ringnet::net::set_option(listening_socket, SO_REUSEPORT);
+		if (!socket_status)
+			return MessagedStatus{ false, "Error setting SO_REUSEPORT option to socket " +
+							      std::string(listening_address) + ":" +
+							      std::to_string(listening_port) + ": " +
+							      socket_status.what() };
+	}
+
 	socket_status = ringnet::net::bind(listening_socket, *resolved_address);
 	if (!socket_status)
 		return MessagedStatus{ false, "Error binding to " + std::string(listening_address) + ":" +
@@ -113,7 +239,8 @@ MessagedStatus Acceptor<DP>::listen(std::string_view listening_address, uint16_t
 
 	ringnet::uring::AcceptRequest request;
 	request.listening_socket_fd = listening_socket.fd;
-	auto uring_status = loop.add(request, subscriber.get());
+	request.direct = (accept_mode == AcceptMode::DIRECT);
+	auto uring_status = loop.add(request, static_cast<CompletionSink *>(accept_sink.get()));
 	if (uring_status == ringnet::uring::QUEUE_FULL)
 		return MessagedStatus{ false, "Request queue is full" };
 
@@ -1,17 +1,24 @@
 #pragma once
 
 #include <array>
+#include <chrono>
+#include <deque>
+#include <limits>
 #include <memory>
 #include <span>
 #include <string_view>
 #include <vector>
 
+#include "ringnet/completionSink.hpp"
+#include "ringnet/coro/operation.hpp"
 #include "ringnet/eventLoop.hpp"
+#include "ringnet/inlineCallback.hpp"
 #include "ringnet/net/endpoint.hpp"
 #include "ringnet/net/sockets.hpp"
 #include "ringnet/status.hpp"
 #include "ringnet/uring/bufferRing.hpp"
 #include "ringnet/uring/requests.hpp"
+#include "ringnet/uring/sendBufferPool.hpp"
 
 namespace ringnet::net
 {
@@ -24,14 +31,97 @@ class Connection {
     public:
 	Connection(ringnet::EventLoop &loop, net::FileDescriptor &&socket);
 
+	/// @brief Connection on a socket of the fixed-file table of the loop: its requests use IOSQE_FIXED_FILE, and
+	/// the slot is freed once the connection is destroyed.
+	Connection(ringnet::EventLoop &loop, net::FixedFile &&socket);
+
 	Connection(Connection &&) = default;
-	Connection &operator=(Connection &&) = default;
+	/// @brief Closes the socket of this connection first, as its destruction does.
+	Connection &operator=(Connection &&other);
 
 	~Connection();
 
 	MessagedStatus asyncRead();
+
+	/// @brief Multi-shot read, where a completion may span several consecutive provided buffers (receive bundle):
+	/// fewer completions for bulk transfers. The read event then lists the buffers in ReadEvent::buffers.
+	/// @return An error status if the kernel does not support receive bundles (Linux 6.10).
+	MessagedStatus asyncReadBundles();
+
+	/// @brief Single write, notified with the bytes actually written: on a short write, the caller resubmits the
+	/// rest. Writes submitted concurrently on the same connection may interleave: see enqueueWrite otherwise.
 	MessagedStatus asyncWrite(std::span<const std::byte> sent_bytes);
 
+	/// @brief Cork the connection: the writes without deadline issued during a loop iteration are gathered into a
+	/// single vectored write, submitted right before the next submission (one at a time: the writes issued in the
+	/// meantime are gathered into the next one). Each write is still notified with its own write event, once
+	/// completely written: the rest of a short write is written first by the next vectored write. Worth it for
+	/// chatty applications, issuing many small writes.
+	/// On error, the error event is notified once, and the writes gathered so far are dropped.
+	/// @param more_to_come Send the gathered writes with MSG_MORE: the kernel may hold a partial segment back until
+	/// the next write (up to 200 ms), to send fuller segments.
+	void setCorked(bool corked, bool more_to_come = false);
+
+	/// @brief Gather several buffers (e.g. header, body and trailer of a frame) into a single write, with a single
+	/// completion. The write event holds the buffers and the number of bytes written across them. Both the buffers
+	/// and the array describing them must outlive the completion.
+	MessagedStatus asyncWritev(std::span<const iovec> buffers);
+
+	/// @brief Write the first bytes of a send buffer leased from the loop (EventLoop::leaseSendBuffer), registered
+	/// with the ring: the kernel does not need to map the pages. The buffer goes back to the pool once written.
+	/// @param length Number of bytes to write, at most the size of the buffer. On failure, the caller keeps the
+	/// buffer.
+	MessagedStatus asyncWrite(uring::SendBuffer &&buffer, size_t length);
+
+	/// @brief Send without copying the bytes into the socket buffers (IORING_OP_SEND_ZC): worth it for large
+	/// payloads (several kilobytes), where the copy dominates. The write event is notified once the kernel no
+	/// longer uses the bytes, which must outlive it.
+	MessagedStatus asyncSendZeroCopy(std::span<const std::byte> sent_bytes);
+
+	/// @brief Queue the bytes for writing, after the bytes queued so far. They are written completely (short writes
+	/// are resumed) and in order, with a single write in flight for the whole queue. A write event is notified once
+	/// all the bytes of the span are written: they must outlive it. On error, the error event is notified and the
+	/// queued bytes are dropped.
+	MessagedStatus enqueueWrite(std::span<const std::byte> sent_bytes);
+
+	/// @brief Number of bytes queued by enqueueWrite, and not written yet.
+	size_t queuedBytes() const;
+
+	/// @brief Backpressure of the write queue: the high watermark callback is invoked once the queued bytes reach
+	/// the high watermark, then the low watermark callback once they drop back to the low watermark.
+	void setWriteWatermarks(size_t low_watermark, size_t high_watermark);
+
+	template <class Func>
+	void onHighWatermark(Func &&callback);
+
+	template <class Func>
+	void onLowWatermark(Func &&callback);
+
+	/// @brief Single read, up to the size of a provided buffer. Renew it from the read callback to keep reading.
+	/// @param timeout If nothing is received within this duration, the read is cancelled and an error event is
+	/// notified, with ETIMEDOUT as error code.
+	MessagedStatus asyncRead(std::chrono::nanoseconds timeout);
+
+	/// @param timeout If the bytes are not written within this duration, the write is cancelled and an error event
+	/// is notified, with ETIMEDOUT as error code.
+	MessagedStatus asyncWrite(std::span<const std::byte> sent_bytes, std::chrono::nanoseconds timeout);
+
+	using ReadOperation = coro::Operation<events::ReadEvent, uring::ProvidedBufferReadRequest>;
+	using ReadIntoOperation = coro::Operation<events::ReadEvent, uring::ReadRequest>;
+	using WriteOperation = coro::Operation<events::WriteEvent, uring::WriteRequest>;
+
+	/// @brief Awaitable single read (C++20 coroutines), up to the size of a provided buffer. The awaiting coroutine
+	/// is resumed directly on completion, with either a read event or an error event.
+	/// @warning The read bytes live in a provided buffer, given back to the kernel once the coroutine next
+	/// suspends: copy them beforehand if needed (e.g. to write them back).
+	[[nodiscard]] ReadOperation read();
+
+	/// @brief Awaitable single read into the given buffer, owned by the caller.
+	[[nodiscard]] ReadIntoOperation read(std::span<std::byte> reception_buffer);
+
+	/// @brief Awaitable write. The bytes must outlive the completion.
+	[[nodiscard]] WriteOperation write(std::span<const std::byte> sent_bytes);
+
 	/// @todo Add concepts
 	template <class Func>
 	void onError(Func &&callback);
@@ -44,35 +134,195 @@ class Connection {
 
 	const Endpoint &endpoint() const;
 
+	/// @brief Read into the provided buffers of this size class (RingConfig::provided_buffers) from now on, e.g.
+	/// small buffers for a control connection, large ones for bulk transfers. The multi-shot reads already armed
+	/// are moved to it.
+	void setBufferClass(size_t size_class);
+
+	size_t bufferClass() const;
+
+	/// @brief Promote the connection to the next size class once PROMOTION_READS reads in a row filled their
+	/// buffer. Only the reads notified to the read callback (onRead) are accounted for.
+	void setBufferPromotion(bool enabled);
+
+	static constexpr unsigned PROMOTION_READS = 4;
+
+	/// @brief Flag the requests of this connection as urgent: they are submitted right away, regardless of the
+	/// batching policy of the loop (e.g. the answers of a request/response protocol, on a loop tuned for bulk
+	/// transfers).
+	void setLatencyCritical(bool latency_critical);
+
     private:
 	std::reference_wrapper<ringnet::EventLoop> loop;
 
 	using FileDescriptor = ringnet::net::FileDescriptor;
 	FileDescriptor socket;
+	/// @brief Set instead of the socket, if the connection was accepted directly into the fixed-file table.
+	net::FixedFile fixed_file{};
 
+	/// @brief Either the socket file descriptor, or its slot in the fixed-file table.
 	Endpoint endpoint_;
 
+	/// @brief Flags of every request issued for this connection.
+	uint8_t request_flags = 0;
+
+	MessagedStatus asyncWrite(std::span<const std::byte> sent_bytes, const uring::LinkedTimeout &timeout);
+
 	/// @brief The addresses of the objects submitted to the kernel should not change until they are completed:
 	/// neither the subscriber, which holds the handles, nor the requests themselves, nor any associated buffer.
 	/// Using smart pointers ensures that their address maintains valid when moving the Connection object around.
-	std::unique_ptr<ringnet::Subscriber> subscriber = std::make_unique<ringnet::Subscriber>();
+	/// Created on first use: connections only used from coroutines do without.
+	std::unique_ptr<ringnet::Subscriber> subscriber_{};
+
+	ringnet::Subscriber *subscriber();
+
+	/// @brief Spans queued by enqueueWrite, written one at a time: the sink of the write in flight, if any. Without
+	/// room for the next write, it is retried on the next flush.
+	struct WriteQueue : CompletionSink, FlushSink {
+		std::reference_wrapper<ringnet::EventLoop> loop;
+		ringnet::Subscriber *subscriber = nullptr;
+		int fd = -1;
+		uint8_t request_flags = 0;
+
+		std::deque<std::span<const std::byte>> spans{};
+		/// @brief Bytes of the front span already written.
+		size_t written = 0;
+		size_t queued_bytes = 0;
+		/// @brief Write in flight, if any: detached if the queue goes away first.
+		uring::RequestHeader *in_flight = nullptr;
+
+		size_t low_watermark = 0;
+		size_t high_watermark = std::numeric_limits<size_t>::max();
+		/// @brief Set once the high watermark is reached, until the low watermark is.
+		bool above_high_watermark = false;
+		InlineCallback<void()> on_high_watermark{};
+		InlineCallback<void()> on_low_watermark{};
+
+		WriteQueue(ringnet::EventLoop &loop_, ringnet::Subscriber *subscriber_, int fd_)
+			: loop(loop_), subscriber(subscriber_), fd(fd_)
+		{
+			notify = &WriteQueue::deliver;
+			flush = &WriteQueue::retryNext;
+		}
+		WriteQueue(const WriteQueue &) = delete;
+		WriteQueue &operator=(const WriteQueue &) = delete;
+
+		~WriteQueue();
+
+		/// @brief Submit a write for the rest of the front span, if none is in flight.
+		/// @return Whether the write could be queued (or did not need to).
+		bool writeNext();
+
+		/// @brief Drop the queued spans, then notify the error.
+		void fail(events::ErrorEvent &&error);
+
+		static void retryNext(FlushSink &sink);
+		static void deliver(CompletionSink &sink, Event &&event);
+	};
+	std::unique_ptr<WriteQueue> write_queue{};
+
+	/// @brief Writes gathered while corked, flushed once per iteration as a single vectored write.
+	struct CorkedWrites : CompletionSink, FlushSink {
+		std::reference_wrapper<ringnet::EventLoop> loop;
+		ringnet::Subscriber *subscriber = nullptr;
+		int fd = -1;
+		uint8_t request_flags = 0;
+		bool more_to_come = false;
+
+		/// @brief Writes not completely written yet, in order, including those of the vectored write in
+		/// flight. A vectored write takes at most IOV_MAX of them: the others wait for the next flush.
+		std::deque<std::span<const std::byte>> pending{};
+		/// @brief Bytes of the front write already written, by a short vectored write.
+		size_t written = 0;
+		/// @brief Rest of the front writes, described by the vectored write in flight, if any.
+		std::vector<iovec> in_flight{};
+		/// @brief Vectored write in flight, if any: detached if the sink goes away first.
+		uring::RequestHeader *writing = nullptr;
+
+		CorkedWrites(ringnet::EventLoop &loop_, ringnet::Subscriber *subscriber_, int fd_)
+			: loop(loop_), subscriber(subscriber_), fd(fd_)
+		{
+			notify = &CorkedWrites::deliver;
+			flush = &CorkedWrites::flushPending;
+		}
+		CorkedWrites(const CorkedWrites &) = delete;
+		CorkedWrites &operator=(const CorkedWrites &) = delete;
+
+		~CorkedWrites()
+		{
+			loop.get().cancelFlush(*this);
+			if (writing)
+				EventLoop::detach(*writing);
+		}
+
+		void add(std::span<const std::byte> sent_bytes, uint8_t flags);
+
+		/// @brief Drop the gathered writes, then notify the error.
+		void fail(events::ErrorEvent &&error);
+
+		static void flushPending(FlushSink &sink);
+		static void deliver(CompletionSink &sink, Event &&event);
+	};
+	std::unique_ptr<CorkedWrites> corked_writes{};
+	bool corked = false;
+
+	WriteQueue &writeQueue();
+
+	/// @brief Size class of the provided buffers read into, promoted as reads fill them if enabled.
+	struct BufferSizing {
+		std::reference_wrapper<ringnet::EventLoop> loop;
+		int fd = -1;
+		uint8_t request_flags = 0;
+		size_t size_class = 0;
+		bool promotion = false;
+		/// @brief Reads in a row that filled their buffer.
+		unsigned full_reads = 0;
+
+		void setClass(size_t size_class_);
+		void observe(const events::ReadEvent &event);
+	};
+	std::unique_ptr<BufferSizing> buffer_sizing{};
+
+	BufferSizing &bufferSizing();
+	uint16_t bufferGroupId() const;
 };
 
 template <class Func>
 void Connection::onError(Func &&callback)
 {
-	subscriber->on<ringnet::events::ErrorEvent>(std::move(callback));
+	subscriber()->on<ringnet::events::ErrorEvent>(std::move(callback));
 }
 
 template <class Func>
 void Connection::onRead(Func &&callback)
 {
-	subscriber->on<ringnet::events::ReadEvent>(std::move(callback));
+	// With a single size class, there is nothing to promote to: the callback is registered as is.
+	if (loop.get().bufferClassesCount() < 2) {
+		subscriber()->on<ringnet::events::ReadEvent>(std::move(callback));
+		return;
+	}
+	subscriber()->on<ringnet::events::ReadEvent>(
+		[sizing = &bufferSizing(), callback = std::move(callback)](ringnet::events::ReadEvent &&event) mutable {
+			sizing->observe(event);
+			callback(std::move(event));
+		});
 }
 
 template <class Func>
 void Connection::onWrite(Func &&callback)
 {
-	subscriber->on<ringnet::events::WriteEvent>(std::move(callback));
+	subscriber()->on<ringnet::events::WriteEvent>(std::move(callback));
+}
+
+template <class Func>
+void Connection::onHighWatermark(Func &&callback)
+{
+	writeQueue().on_high_watermark = std::forward<Func>(callback);
+}
+
+template <class Func>
+void Connection::onLowWatermark(Func &&callback)
+{
+	writeQueue().on_low_watermark = std::forward<Func>(callback);
 }
 } // namespace ringnet::net
\ No newline at end of file
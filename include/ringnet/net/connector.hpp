@@ -1,11 +1,17 @@
 #pragma once
 
 #include <array>
+#include <chrono>
 #include <span>
 #include <string_view>
 #include <vector>
 
+#include <tl/expected.hpp>
+
+#include "ringnet/coro/operation.hpp"
+#include "ringnet/coro/task.hpp"
 #include "ringnet/eventLoop.hpp"
+#include "ringnet/net/connection.hpp"
 #include "ringnet/net/sockets.hpp"
 #include "ringnet/status.hpp"
 #include "ringnet/uring/requests.hpp"
@@ -40,7 +46,25 @@ class Connector {
 
 	MessagedStatus asyncConnect(std::string_view server_address, uint16_t server_port);
 
+	/// @param timeout If the connection is not established within this duration, it is cancelled and an error event
+	/// is notified, with ETIMEDOUT as error code.
+	MessagedStatus asyncConnect(std::string_view server_address, uint16_t server_port,
+				    std::chrono::nanoseconds timeout);
+
+	/// @brief Awaitable connection (C++20 coroutines). The awaiting coroutine is resumed directly on completion.
+	/// @return The connection, or an error event. Failing to resolve the address or to set the socket up is
+	/// reported with EADDRNOTAVAIL as error code.
+	coro::Task<tl::expected<Connection, events::ErrorEvent>> connect(std::string server_address,
+									  uint16_t server_port);
+
     private:
+	MessagedStatus asyncConnect(std::string_view server_address, uint16_t server_port,
+				    const uring::LinkedTimeout &timeout);
+
+	/// @brief Resolve the address and open the socket, then fill the connection request in.
+	MessagedStatus prepareConnection(std::string_view server_address, uint16_t server_port,
+					 ringnet::uring::ConnectRequest &request);
+
 	ringnet::EventLoop &loop;
 	std::unique_ptr<ringnet::Subscriber> subscriber = std::make_unique<ringnet::Subscriber>();
 
@@ -61,7 +85,7 @@ template <DatagramProtocol DP>
 Connector<DP>::~Connector()
 {
 	if (socket)
-		loop.cancel(socket.fd);
+		loop.closeFile(socket.release());
 }
 
 template <DatagramProtocol DP>
@@ -83,6 +107,57 @@ void Connector<DP>::onConnection(Func user_callback)
 
 template <DatagramProtocol DP>
 MessagedStatus Connector<DP>::asyncConnect(std::string_view server_address, uint16_t server_port)
+{
+	return asyncConnect(server_address, server_port, uring::LinkedTimeout{});
+}
+
+template <DatagramProtocol DP>
+MessagedStatus Connector<DP>::asyncConnect(std::string_view server_address, uint16_t server_port,
+					   std::chrono::nanoseconds timeout)
+{
+	return asyncConnect(server_address, server_port, uring::LinkedTimeout::after(timeout));
+}
+
+template <DatagramProtocol DP>
+MessagedStatus Connector<DP>::asyncConnect(std::string_view server_address, uint16_t server_port,
+					   const uring::LinkedTimeout &timeout)
+{
+	ringnet::uring::ConnectRequest request;
+	MessagedStatus prepare_status = prepareConnection(server_address, server_port, request);
+	if (!prepare_status)
+		return prepare_status;
+	request.timeout = timeout;
+
+	auto status = loop.add(request, subscriber.get());
+	if (status == ringnet::uring::QUEUE_FULL)
+		return MessagedStatus{ false, "Request queue is full" };
+
+	connection_status = Status::PENDING;
+	return MessagedStatus{ true, "Pending connection" };
+}
+
+template <DatagramProtocol DP>
+coro::Task<tl::expected<Connection, events::ErrorEvent>> Connector<DP>::connect(std::string server_address,
+										 uint16_t server_port)
+{
+	ringnet::uring::ConnectRequest request;
+	if (!prepareConnection(server_address, server_port, request))
+		co_return tl::unexpected(events::ErrorEvent{ .error_code = EADDRNOTAVAIL });
+
+	connection_status = Status::PENDING;
+	auto connected = co_await coro::Operation<events::ConnectEvent, uring::ConnectRequest>{ loop, request };
+	if (!connected) {
+		connection_status = Status::DISCONNECTED;
+		co_return tl::unexpected(connected.error());
+	}
+
+	connection_status = Status::CONNECTED;
+	co_return Connection{ loop, std::move(socket) };
+}
+
+template <DatagramProtocol DP>
+MessagedStatus Connector<DP>::prepareConnection(std::string_view server_address, uint16_t server_port,
+						ringnet::uring::ConnectRequest &request)
 {
 	if (connection_status == Status::PENDING)
 		return MessagedStatus{ false, "Already pending connection" };
@@ -102,16 +177,9 @@ MessagedStatus Connector<DP>::asyncConnect(std::string_view server_address, uint
 						      std::string(server_address) + ":" + std::to_string(server_port) +
 						      ": " + socket_status.what() };
 
-	ringnet::uring::ConnectRequest request;
 	request.socket_fd = socket.fd;
 	std::tie(request.addr, request.addrlen) = resolved_address->as_sockaddr();
-
-	auto status = loop.add(request, subscriber.get());
-	if (status == ringnet::uring::QUEUE_FULL)
-		return MessagedStatus{ false, "Request queue is full" };
-
-	connection_status = Status::PENDING;
-	return MessagedStatus{ true, "Pending connection" };
+	return MessagedStatus{ true, "Socket ready" };
 }
 
 } // namespace ringnet::net
\ No newline at end of file
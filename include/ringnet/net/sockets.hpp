@@ -35,6 +35,10 @@ struct FileDescriptorStatus;
 /// It stores the address once resolved.
 class FileDescriptor;
 
+/// @brief Slot of a socket in the fixed-file table of an event loop (e.g. accepted directly into it). Move-only, like
+/// FileDescriptor, but freeing the slot requires the loop: left to the owner (see Connection).
+class FixedFile;
+
 /// @brief Wrap the linux sockaddr_in or sockaddr_in6 in a variant and expose some utilities.
 struct SocketAddress;
 
@@ -59,7 +63,9 @@ struct FileDescriptorStatus {
 	static constexpr int SUCCESS = 0;
 	explicit FileDescriptorStatus() : return_code(SUCCESS){};
 
-	explicit FileDescriptorStatus(int return_code_) : return_code(USE_ERRNO ? errno : return_code_){};
+	/// @note When USE_ERRNO is set, errno is only relevant if the call failed: it is not reset on success.
+	explicit FileDescriptorStatus(int return_code_)
+		: return_code((USE_ERRNO && return_code_ < 0) ? errno : return_code_){};
 
 	inline operator bool() const
 	{
@@ -92,6 +98,9 @@ class FileDescriptor {
 
 	~FileDescriptor();
 
+	/// @brief Give up the ownership of the file descriptor, left open (e.g. to close it asynchronously).
+	Raw release();
+
 	inline explicit operator Raw() const;
 	inline explicit operator bool() const;
 
@@ -99,6 +108,29 @@ class FileDescriptor {
 	static constexpr Raw INVALID = -1;
 };
 
+class FixedFile {
+    public:
+	using Index = int;
+	Index index{ INVALID };
+
+	FixedFile() = default;
+	explicit FixedFile(Index index);
+	FixedFile(const FixedFile &) = delete;
+	FixedFile &operator=(const FixedFile &) = delete;
+	FixedFile(FixedFile &&);
+	FixedFile &operator=(FixedFile &&);
+
+	inline explicit operator bool() const;
+
+    private:
+	static constexpr Index INVALID = -1;
+};
+
+inline FixedFile::operator bool() const
+{
+	return (index >= 0);
+}
+
 inline FileDescriptor::operator Raw() const
 {
 	return fd;
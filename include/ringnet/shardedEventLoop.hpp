@@ -0,0 +1,119 @@
+#pragma once
+
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "ringnet/eventLoop.hpp"
+
+namespace ringnet
+{
+
+/// @brief Thread-per-core runtime: N independent event loops, each one running on its own thread, with its own
+/// io_uring instance and its own provided buffers.
+/// Shards share nothing: a resource (acceptor, connector, connection) belongs to the loop it was created with, and must
+/// only be used from that loop's thread. Combined with the REUSE_PORT listening mode of the Acceptor, each shard
+/// accepts its own share of the incoming connections, which then stay on the core that accepted them.
+class ShardedEventLoop {
+    public:
+	/// @param shards_count Number of loops, hence of threads.
+	/// @param request_queue_size Submission queue size of each loop.
+	/// @param pin_threads If set, each shard thread is pinned to its own core.
+	/// @param ring_config io_uring setup options, applied to the ring of each shard.
+	ShardedEventLoop(size_t shards_count, size_t request_queue_size, bool pin_threads = true,
+			 const uring::RingConfig &ring_config = {});
+
+	ShardedEventLoop(const ShardedEventLoop &) = delete;
+	ShardedEventLoop &operator=(const ShardedEventLoop &) = delete;
+
+	~ShardedEventLoop();
+
+	/// @brief Start one thread per shard, then block until every loop is stopped.
+	/// Each thread creates its own loop, then calls setup(loop, shard_index) before running it. Whatever setup
+	/// returns (typically the acceptor of the shard, and its connections) is kept alive until the loop stops, then
+	/// destroyed on the shard thread.
+	/// @tparam Setup Callable taking an EventLoop reference and the shard index.
+	/// @param setup Shard initialization, called concurrently from every shard thread.
+	/// @throw Rethrows the first exception raised by a shard (e.g. failing io_uring initialization), after stopping
+	/// the other ones.
+	template <class Setup>
+	void run(Setup &&setup);
+
+	/// @brief Stop all loops. Can be called from any thread, including from a shard. Sticky: if called before
+	/// run(), run() still creates the loops and calls the setup of each shard, but then returns without running
+	/// them, until restart() is called.
+	void stop();
+
+	/// @brief Allow run() again, once stopped.
+	void restart();
+
+	size_t size() const;
+
+    private:
+	size_t shards_count;
+	size_t request_queue_size;
+	bool pin_threads;
+	uring::RingConfig ring_config;
+
+	std::mutex loops_mutex{};
+	std::vector<EventLoop *> loops{};
+	bool stopped = false;
+	std::exception_ptr first_error{};
+
+	template <class Setup>
+	void runShard(Setup &setup, size_t shard_index);
+
+	/// @brief Run a shard loop, making it reachable by stop() while running. Does not run it at all if stop() was
+	/// already called.
+	void runLoop(EventLoop &loop);
+	void fail(std::exception_ptr error);
+
+	void pin(size_t shard_index);
+};
+
+template <class Setup>
+void ShardedEventLoop::run(Setup &&setup)
+{
+	{
+		std::lock_guard<std::mutex> lock{ loops_mutex };
+		first_error = nullptr;
+	}
+
+	std::vector<std::thread> threads{};
+	threads.reserve(shards_count);
+	for (size_t shard_index = 0; shard_index < shards_count; shard_index++)
+		threads.emplace_back([this, &setup, shard_index]() { runShard(setup, shard_index); });
+
+	for (std::thread &thread : threads)
+		thread.join();
+
+	if (first_error)
+		std::rethrow_exception(first_error);
+}
+
+template <class Setup>
+void ShardedEventLoop::runShard(Setup &setup, size_t shard_index)
+{
+	try {
+		if (pin_threads)
+			pin(shard_index);
+
+		// The loop is created on its own thread: the ring is then owned by the thread submitting to it.
+		auto loop = std::make_unique<EventLoop>(request_queue_size, ring_config);
+
+		if constexpr (std::is_void_v<std::invoke_result_t<Setup &, EventLoop &, size_t>>) {
+			setup(*loop, shard_index);
+			runLoop(*loop);
+		} else {
+			auto shard_state = setup(*loop, shard_index);
+			runLoop(*loop);
+		}
+	} catch (...) {
+		fail(std::current_exception());
+	}
+}
+
+} // namespace ringnet
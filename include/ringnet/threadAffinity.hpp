@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <thread>
+
+namespace ringnet
+{
+
+/// @brief Debug check of single-threaded objects: the first thread to use the object owns it, and any later use from
+/// another thread fails an assertion. Compiled out, and empty, with NDEBUG.
+class ThreadAffinity {
+    public:
+	/// @brief Own the object from the calling thread on first call, then check that the calling thread owns it.
+	void check() noexcept
+	{
+#ifndef NDEBUG
+		std::thread::id current_owner{};
+		if (!owner.compare_exchange_strong(current_owner, std::this_thread::get_id()))
+			assert(current_owner == std::this_thread::get_id() &&
+			       "Object used from another thread than its own");
+#endif
+	}
+
+	/// @brief Check that the calling thread owns the object, if any thread does yet.
+	void checkIfOwned() const noexcept
+	{
+#ifndef NDEBUG
+		[[maybe_unused]] const std::thread::id current_owner = owner.load();
+		assert((current_owner == std::thread::id{} || current_owner == std::this_thread::get_id()) &&
+		       "Object used from another thread than its own");
+#endif
+	}
+
+#ifndef NDEBUG
+    private:
+	std::atomic<std::thread::id> owner{};
+#endif
+};
+
+} // namespace ringnet
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+#include "ringnet/inlineCallback.hpp"
+#include "ringnet/traits/movable.hpp"
+
+namespace ringnet::time
+{
+class TimerWheel;
+
+/// @brief Intrusive doubly linked list node. A wheel slot is a circular list, whose sentinel is the slot itself.
+struct TimerLink {
+	TimerLink *previous = this;
+	TimerLink *next = this;
+
+	TimerLink() = default;
+	TimerLink(const TimerLink &) = delete;
+	TimerLink &operator=(const TimerLink &) = delete;
+
+	bool empty() const
+	{
+		return next == this;
+	}
+
+	void unlink()
+	{
+		previous->next = next;
+		next->previous = previous;
+		previous = next = this;
+	}
+
+	void pushBack(TimerLink &link)
+	{
+		link.previous = previous;
+		link.next = this;
+		previous->next = &link;
+		previous = &link;
+	}
+};
+
+/// @brief Timer owned by the caller, and linked into a wheel while scheduled: scheduling does not allocate.
+/// Do not move a timer: the wheel refers to its address until it expires or is cancelled. A timer destroyed while
+/// scheduled is cancelled.
+class Timer : private TimerLink, public traits::NonMovable {
+    public:
+	using Callback = InlineCallback<void()>;
+
+	Timer() = default;
+	explicit Timer(Callback callback_) : callback(std::move(callback_)){};
+	~Timer();
+
+	Timer(const Timer &) = delete;
+	Timer &operator=(const Timer &) = delete;
+
+	/// @brief Set the callback invoked on expiry. It may reschedule the timer.
+	void onExpiry(Callback callback_)
+	{
+		callback = std::move(callback_);
+	}
+
+	bool scheduled() const
+	{
+		return wheel != nullptr;
+	}
+
+    private:
+	friend class TimerWheel;
+
+	TimerWheel *wheel = nullptr;
+	uint64_t expiry_tick = 0;
+	/// @brief Level of the wheel the timer is linked into, while scheduled.
+	size_t level = 0;
+	Callback callback{};
+};
+
+/// @brief Hierarchical timer wheel. Timers are hashed into slots by expiry tick: scheduling, cancelling and
+/// rescheduling are O(1). The first level holds the timers expiring within SLOTS_PER_LEVEL ticks, one slot per tick.
+/// Each next level covers SLOTS_PER_LEVEL times the range of the previous one: its timers are moved down (cascaded)
+/// once their slot comes within range of the lower level.
+/// With the default 1 ms resolution, timers are exact up to the tick, over a range of about 50 days. Timers beyond
+/// are kept in the last level until they come within range.
+/// @warning Not thread-safe: owned by an event loop, and used from its thread only.
+class TimerWheel {
+    public:
+	using Clock = std::chrono::steady_clock;
+
+	static constexpr unsigned SLOT_BITS = 8;
+	static constexpr size_t SLOTS_PER_LEVEL = size_t{ 1 } << SLOT_BITS;
+	static constexpr size_t LEVELS = 4;
+	static constexpr std::chrono::milliseconds DEFAULT_RESOLUTION{ 1 };
+
+	explicit TimerWheel(Clock::duration resolution = DEFAULT_RESOLUTION, Clock::time_point origin = Clock::now());
+	~TimerWheel();
+
+	TimerWheel(const TimerWheel &) = delete;
+	TimerWheel &operator=(const TimerWheel &) = delete;
+
+	/// @brief Schedule the timer to expire once the deadline is reached (rounded up to the next tick, and at least
+	/// one tick ahead). Reschedule it if already scheduled.
+	void schedule(Timer &timer, Clock::time_point deadline);
+
+	/// @brief Remove the timer from the wheel, if scheduled. Its callback will not be invoked.
+	void cancel(Timer &timer);
+
+	/// @brief Move the wheel forward up to the given time, invoking the callbacks of the expired timers in order.
+	/// @return The number of expired timers.
+	size_t advance(Clock::time_point now);
+
+	/// @brief When the wheel next needs to be advanced: the earliest expiry among all the timers. Cascades do not
+	/// need a wakeup of their own: advancing the wheel runs them, skipping the empty ranges of the lower levels.
+	/// Cancelling timers of the upper levels may make it earlier than needed, never later.
+	/// @return Nothing if no timer is scheduled.
+	std::optional<Clock::time_point> nextDeadline() const;
+
+	size_t size() const
+	{
+		return timers_count;
+	}
+
+	bool empty() const
+	{
+		return timers_count == 0;
+	}
+
+    private:
+	using Level = std::array<TimerLink, SLOTS_PER_LEVEL>;
+	std::array<Level, LEVELS> levels{};
+
+	const Clock::duration resolution;
+	const Clock::time_point origin;
+	/// @brief Last processed tick.
+	uint64_t current_tick = 0;
+	size_t timers_count = 0;
+	/// @brief Number of timers linked into each level.
+	std::array<size_t, LEVELS> level_counts{};
+	/// @brief Earliest expiry tick of the timers linked into each slot, kept on insert rather than walking the
+	/// slot. Not raised when a timer is cancelled: a lower bound until the slot is emptied.
+	std::array<std::array<uint64_t, SLOTS_PER_LEVEL>, LEVELS> slot_expiries{};
+
+	/// @brief Link the timer into the slot matching its expiry tick, relatively to the current tick.
+	void insert(Timer &timer);
+
+	/// @brief Move the timers of the current slot of the given level down, from the highest level reaching a
+	/// boundary to the first level.
+	void cascade();
+
+	/// @brief Invoke the callbacks of the timers of the current first level slot.
+	size_t expire();
+
+	/// @brief Earliest expiry tick among the timers of the level, if any: they are all in its first non-empty slot.
+	/// Exact on the first level, whose slots hold a single tick each.
+	std::optional<uint64_t> earliestExpiry(size_t level) const;
+
+	uint64_t tickOf(Clock::time_point time) const;
+};
+
+} // namespace ringnet::time
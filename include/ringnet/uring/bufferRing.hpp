@@ -1,49 +1,65 @@
 #pragma once
 
+#include <algorithm>
+#include <cerrno>
 #include <memory>
 #include <optional>
 #include <utility>
 #include <vector>
 
 #include <liburing.h>
+#include <sys/mman.h>
 
 #include "ringnet/status.hpp"
 
 namespace ringnet::uring
 {
+// Defined by liburing 2.8 onwards.
+#ifndef IOU_PBUF_RING_INC
+#define IOU_PBUF_RING_INC 2
+#endif
+#ifndef IORING_CQE_F_BUF_MORE
+#define IORING_CQE_F_BUF_MORE (1U << 4)
+#endif
+
 template <class Buffer>
 class BufferRing {
 	static_assert(sizeof(typename Buffer::value_type) == 1, "Buffer element type must be of byte size");
 	using BufferView = std::span<typename Buffer::value_type>;
-	static constexpr uint FLAGS = 0;
+	using ConstBufferView = std::span<const typename Buffer::value_type>;
 
     public:
-	static constexpr int BUFFER_GROUP_ID = 1;
-	BufferRing(io_uring &io_ring_) : io_ring(std::ref(io_ring_))
+	BufferRing(io_uring &io_ring_, uint16_t group_id_) : io_ring(std::ref(io_ring_)), group_id(group_id_)
 	{
 	}
 
-	MessagedStatus setupBuffers(std::span<Buffer> buffers_)
+	/// @param incremental_ Let the kernel consume the buffers incrementally (IOU_PBUF_RING_INC, Linux 6.12): a
+	/// buffer is filled by successive receives, each one starting where the previous one stopped, until it is full.
+	/// Falls back to whole buffers if the kernel does not support it (see incremental()).
+	MessagedStatus setupBuffers(std::span<Buffer> buffers_, bool incremental_ = false)
 	{
 		if (!isPowerOfTwo(buffers_.size()))
 			return MessagedStatus{ false, "The number of entries must be a power of two" };
 
-		if (buffer_ring)
-			io_uring_free_buf_ring(&(io_ring.get()), buffer_ring, buffers.size(), BUFFER_GROUP_ID);
+		// Reset right away: if both setups below fail, the destructor must not free it again.
+		if (buffer_ring) {
+			io_uring_free_buf_ring(&(io_ring.get()), buffer_ring, buffers.size(), group_id);
+			buffer_ring = nullptr;
+		}
 
 		buffers = buffers_;
-
-		int status{};
-		buffer_ring =
-			io_uring_setup_buf_ring(&(io_ring.get()), buffers.size(), BUFFER_GROUP_ID, FLAGS, &status);
-
-		if (!buffer_ring)
+		incremental_ = incremental_ && setupRing(IOU_PBUF_RING_INC);
+		if (!incremental_ && !setupRing(0))
 			return MessagedStatus{ false, strerror(-status) };
+		incremental_consumption = incremental_;
 
+		positions.assign(buffers.size(), 0);
+		offsets.assign(buffers.size(), 0);
 		for (size_t buffer_id = 0; buffer_id < buffers.size(); buffer_id++) {
 			Buffer &buffer = buffers[buffer_id];
 			io_uring_buf_ring_add(buffer_ring, buffer.data(), buffer.size(), buffer_id,
 					      io_uring_buf_ring_mask(buffers.size()), buffer_id);
+			positions[buffer_id] = static_cast<uint16_t>(buffer_ring->tail + buffer_id);
 		}
 		io_uring_buf_ring_advance(buffer_ring, buffers.size());
 
@@ -56,40 +72,162 @@ class BufferRing {
 	~BufferRing()
 	{
 		if (buffer_ring)
-			io_uring_free_buf_ring(&(io_ring.get()), buffer_ring, buffers.size(), BUFFER_GROUP_ID);
+			io_uring_free_buf_ring(&(io_ring.get()), buffer_ring, buffers.size(), group_id);
 	}
 
+	uint16_t groupId() const
+	{
+		return group_id;
+	}
+
+	/// @brief Size of each buffer of the group.
+	size_t bufferSize() const
+	{
+		return buffers.empty() ? 0 : buffers.front().size();
+	}
+
+	/// @brief Whether the buffers are consumed incrementally.
+	bool incremental() const
+	{
+		return incremental_consumption;
+	}
+
+	/// @return The selected buffer, from the first byte received by the completion on.
 	std::optional<BufferView> get(const io_uring_cqe *cqe)
 	{
-		if (!(cqe->flags | IORING_CQE_F_BUFFER))
+		if (!(cqe->flags & IORING_CQE_F_BUFFER))
 			return std::nullopt;
 
 		const int buffer_id = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
 		if (buffer_id < 0 || buffer_id > (static_cast<int>(buffers.size()) - 1))
 			return std::nullopt;
 
-		return buffers[buffer_id];
+		return BufferView{ buffers[buffer_id] }.subspan(offsets[buffer_id]);
 	}
 
+	/// @brief Bytes received by a bundled receive (IORING_RECVSEND_BUNDLE): they fill consecutive entries of the
+	/// ring, starting with the buffer selected by the completion, each one but the last up to its end.
+	/// @param views Cleared, then filled with a view per buffer.
+	/// @return Whether the completion selected a valid buffer.
+	/// @note The entries are still in the ring: completions are handled in the order the kernel consumed their
+	/// buffers, and the entries of a completion can only be overwritten once its own buffers are given back.
+	bool getBundle(const io_uring_cqe *cqe, std::vector<ConstBufferView> &views)
+	{
+		views.clear();
+		if (!get(cqe).has_value())
+			return false;
+
+		for (const Segment &segment : segments(cqe)) {
+			const ConstBufferView buffer{ buffers[segment.buffer_id] };
+			views.push_back(buffer.subspan(segment.offset, segment.length));
+		}
+		return true;
+	}
+
+	/// @brief Give the buffers selected by the completion (a single one, or a bundle) back to the ring. When
+	/// consumed incrementally, the last buffer is only given back once the kernel is done with it (no
+	/// IORING_CQE_F_BUF_MORE): until then, the next receive goes on filling it.
 	void release(const io_uring_cqe *cqe)
 	{
-		if (cqe->flags | IORING_CQE_F_BUFFER) {
-			const size_t buffer_id = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
-			Buffer &buffer = buffers[buffer_id];
-			io_uring_buf_ring_add(buffer_ring, buffer.data(), buffer.size(), buffer_id,
-					      io_uring_buf_ring_mask(buffers.size()), 0);
-			io_uring_buf_ring_advance(buffer_ring, 1);
+		if (!(cqe->flags & IORING_CQE_F_BUFFER))
+			return;
+		// Nothing was committed: the kernel keeps the buffer at the head of the ring.
+		if (incremental_consumption && cqe->res <= 0)
+			return;
+
+		// Collected first: giving buffers back overwrites the entries they were read from.
+		const std::vector<Segment> &selected = segments(cqe);
+		for (size_t index = 0; index < selected.size(); index++) {
+			const Segment &segment = selected[index];
+			if (index + 1 == selected.size() && (cqe->flags & IORING_CQE_F_BUF_MORE))
+				offsets[segment.buffer_id] = segment.offset + segment.length;
+			else
+				release(segment.buffer_id);
 		}
 	}
 
     private:
 	std::reference_wrapper<io_uring> io_ring;
+	uint16_t group_id = 0;
 	io_uring_buf_ring *buffer_ring = nullptr;
 	std::span<Buffer> buffers{};
+	bool incremental_consumption = false;
+	int status = 0;
+
+	/// @brief Ring position each buffer was last added at, by buffer ID.
+	std::vector<uint16_t> positions{};
+	/// @brief Bytes of each buffer already consumed by the kernel, by buffer ID. Always zero unless incremental.
+	std::vector<uint32_t> offsets{};
+
+	/// @brief Part of a buffer filled by a completion.
+	struct Segment {
+		uint16_t buffer_id;
+		uint32_t offset;
+		uint32_t length;
+	};
+	std::vector<Segment> selected_segments{};
+
+	/// @brief Register the ring by hand: io_uring_setup_buf_ring ignores its flags up to liburing 2.7. Freed by
+	/// io_uring_free_buf_ring all the same.
+	bool setupRing(uint16_t flags)
+	{
+		const size_t ring_size = buffers.size() * sizeof(io_uring_buf);
+		void *memory = mmap(nullptr, ring_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+		if (memory == MAP_FAILED) {
+			status = -errno;
+			return false;
+		}
+
+		io_uring_buf_reg registration{};
+		registration.ring_addr = reinterpret_cast<uintptr_t>(memory);
+		registration.ring_entries = static_cast<uint32_t>(buffers.size());
+		registration.bgid = group_id;
+		registration.flags = flags;
+		status = io_uring_register_buf_ring(&(io_ring.get()), &registration, 0);
+		if (status < 0) {
+			munmap(memory, ring_size);
+			return false;
+		}
+
+		buffer_ring = static_cast<io_uring_buf_ring *>(memory);
+		io_uring_buf_ring_init(buffer_ring);
+		return true;
+	}
+
+	void release(uint16_t buffer_id)
+	{
+		Buffer &buffer = buffers[buffer_id];
+		positions[buffer_id] = buffer_ring->tail;
+		offsets[buffer_id] = 0;
+		io_uring_buf_ring_add(buffer_ring, buffer.data(), buffer.size(), buffer_id,
+				      io_uring_buf_ring_mask(buffers.size()), 0);
+		io_uring_buf_ring_advance(buffer_ring, 1);
+	}
+
+	/// @brief Buffers filled by a completion: the selected one, from where the previous completion stopped if
+	/// consumed incrementally, then the ones following it in the ring, for bundles.
+	const std::vector<Segment> &segments(const io_uring_cqe *cqe)
+	{
+		selected_segments.clear();
+		const uint16_t first_id = static_cast<uint16_t>(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+		const uint16_t mask = static_cast<uint16_t>(io_uring_buf_ring_mask(buffers.size()));
+		size_t left = static_cast<size_t>(std::max(cqe->res, 0));
+		uint16_t position = positions[first_id];
+		uint32_t offset = offsets[first_id];
+		do {
+			const uint16_t buffer_id = buffer_ring->bufs[position & mask].bid;
+			const size_t length = std::min(buffers[buffer_id].size() - offset, left);
+			selected_segments.push_back(Segment{ buffer_id, offset, static_cast<uint32_t>(length) });
+			left -= length;
+			offset = 0;
+			position++;
+		} while (left > 0);
+		return selected_segments;
+	}
 
 	inline bool isPowerOfTwo(size_t n)
 	{
 		return ((n & (n - 1)) == 0);
 	}
 };
-} // namespace ringnet::uring
\ No newline at end of file
+} // namespace ringnet::uring
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+
+#include "ringnet/uring/requestPool.hpp"
+
+namespace ringnet::uring
+{
+
+/// @brief Intrusive, lock-free multiple producers / single consumer FIFO of pending requests (Vyukov's algorithm).
+/// Requests are linked through their slot: pushing does neither lock nor allocate, and requests are popped in the
+/// order they were pushed, whatever their type.
+/// Any thread may push. Only the thread owning the ring pops.
+class RequestInbox {
+	std::atomic<SlotLink *> head;
+	SlotLink *tail;
+	SlotLink stub{};
+
+    public:
+	RequestInbox() : head(&stub), tail(&stub){};
+	RequestInbox(const RequestInbox &) = delete;
+	RequestInbox &operator=(const RequestInbox &) = delete;
+
+	void push(SlotLink *link)
+	{
+		link->next.store(nullptr, std::memory_order_relaxed);
+		SlotLink *previous = head.exchange(link, std::memory_order_acq_rel);
+		// Between the exchange and this store, the consumer sees the list as cut short: it stops there, and
+		// gets the rest on its next pop.
+		previous->next.store(link, std::memory_order_release);
+	}
+
+	/// @return The oldest pending request, or nullptr if none is (fully) pushed yet.
+	SlotLink *pop()
+	{
+		SlotLink *oldest = tail;
+		SlotLink *next = oldest->next.load(std::memory_order_acquire);
+
+		if (oldest == &stub) {
+			if (!next)
+				return nullptr;
+			tail = next;
+			oldest = next;
+			next = next->next.load(std::memory_order_acquire);
+		}
+
+		if (next) {
+			tail = next;
+			return oldest;
+		}
+
+		// The oldest request is also the newest: it can only be popped once a successor is linked. Push the
+		// stub behind it, unless a producer is already linking one.
+		if (oldest != head.load(std::memory_order_acquire))
+			return nullptr;
+		push(&stub);
+
+		next = oldest->next.load(std::memory_order_acquire);
+		if (!next)
+			return nullptr;
+		tail = next;
+		return oldest;
+	}
+};
+
+} // namespace ringnet::uring
@@ -1,25 +1,174 @@
 #pragma once
 
-#include <memory_resource>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <tuple>
+#include <type_traits>
+
+#include "ringnet/uring/requests.hpp"
 
 namespace ringnet::uring
 {
 
+/// @brief Intrusive link of a request slot. A slot is either free (linked in a pool free list), pending (linked in
+/// the submission inbox) or in flight (unlinked): a single link serves both lists.
+struct SlotLink {
+	std::atomic<SlotLink *> next{ nullptr };
+};
+
+/// @brief Storage of a request, prefixed with its intrusive link.
+template <class Request>
+struct RequestSlot {
+	SlotLink link{};
+	Request request{};
+
+	static RequestSlot *from(SlotLink *link)
+	{
+		return reinterpret_cast<RequestSlot *>(link);
+	}
+
+	static RequestSlot *from(Request *request)
+	{
+		return reinterpret_cast<RequestSlot *>(reinterpret_cast<std::byte *>(request) -
+						       offsetof(RequestSlot, request));
+	}
+};
+
+/// @brief All requests start with their header, and are stored right after the slot link: the header of a pending
+/// request can be reached from its link without knowing the request type.
+inline RequestHeader *headerOf(SlotLink *link)
+{
+	return reinterpret_cast<RequestHeader *>(reinterpret_cast<std::byte *>(link) + sizeof(SlotLink));
+}
+
+/// @brief Lock-free LIFO of free slots (Treiber stack). Any thread may pop a slot to fill in a new request.
+/// The head is tagged with a modification counter, stored in the unused upper bits of the pointer: a slot popped then
+/// pushed back between the load and the compare-exchange of another thread changes the tag, preventing ABA.
+class FreeList {
+	static_assert(sizeof(uintptr_t) == sizeof(uint64_t), "Tagged pointers require 64-bit addresses");
+	static constexpr unsigned POINTER_BITS = 48;
+	static constexpr uint64_t POINTER_MASK = (uint64_t{ 1 } << POINTER_BITS) - 1;
+
+	std::atomic<uint64_t> head{ 0 };
+
+	static SlotLink *pointerOf(uint64_t tagged)
+	{
+		return reinterpret_cast<SlotLink *>(static_cast<uintptr_t>(tagged & POINTER_MASK));
+	}
+
+	static uint64_t retag(SlotLink *link, uint64_t previous)
+	{
+		const uint64_t tag = (previous >> POINTER_BITS) + 1;
+		return (tag << POINTER_BITS) | (reinterpret_cast<uintptr_t>(link) & POINTER_MASK);
+	}
+
+    public:
+	void push(SlotLink *link)
+	{
+		uint64_t current = head.load(std::memory_order_relaxed);
+		do {
+			link->next.store(pointerOf(current), std::memory_order_relaxed);
+		} while (!head.compare_exchange_weak(current, retag(link, current), std::memory_order_release,
+						     std::memory_order_relaxed));
+	}
+
+	/// @return A free slot, or nullptr if the list is empty.
+	SlotLink *pop()
+	{
+		uint64_t current = head.load(std::memory_order_acquire);
+		while (SlotLink *link = pointerOf(current)) {
+			// The slot may have been popped (and its link rewritten) concurrently: the tag then makes the
+			// exchange fail.
+			SlotLink *next = link->next.load(std::memory_order_relaxed);
+			if (head.compare_exchange_weak(current, retag(next, current), std::memory_order_acquire,
+						       std::memory_order_acquire))
+				return link;
+		}
+		return nullptr;
+	}
+};
+
+/// @brief Pool of request slots: one slab per request type, with a fixed capacity, allocated and constructed with the
+/// pool (which writes to every page: none faults on first use). Allocation is lock-free, can happen on any thread, and
+/// never calls the system allocator. Once a slab is exhausted, allocation fails until requests are given back.
+template <class... Requests>
 class RequestPool {
-	std::pmr::unsynchronized_pool_resource resource{};
+	template <class Request>
+	struct Slab {
+		RequestSlot<Request> *slots = nullptr;
+		FreeList free_list{};
+	};
+
+	size_t capacity_;
+	std::tuple<Slab<Requests>...> slabs{};
+
+	template <class Request>
+	Slab<Request> &slab()
+	{
+		return std::get<Slab<Request>>(slabs);
+	}
+
+	template <class Request>
+	void preallocate()
+	{
+		using Slot = RequestSlot<Request>;
+		static_assert(std::is_trivially_destructible_v<Slot>, "Slots are released with the pool");
+		static_assert(offsetof(Slot, request) == sizeof(SlotLink), "Request header must follow the slot link");
+
+		Slab<Request> &slab_ = slab<Request>();
+		void *memory = ::operator new(sizeof(Slot) * capacity_, std::align_val_t{ alignof(Slot) });
+		slab_.slots = static_cast<Slot *>(memory);
+		// Pushed backwards: slots are first allocated in address order.
+		for (size_t index = capacity_; index > 0; index--)
+			slab_.free_list.push(&(new (&slab_.slots[index - 1]) Slot{})->link);
+	}
+
+	template <class Request>
+	void release()
+	{
+		::operator delete(slab<Request>().slots, std::align_val_t{ alignof(RequestSlot<Request>) });
+	}
 
     public:
+	/// @param capacity Number of slots of each request type.
+	explicit RequestPool(size_t capacity) : capacity_(capacity)
+	{
+		(preallocate<Requests>(), ...);
+	}
+
+	~RequestPool()
+	{
+		(release<Requests>(), ...);
+	}
+
+	RequestPool(const RequestPool &) = delete;
+	RequestPool &operator=(const RequestPool &) = delete;
+
+	/// @return A request slot, or nullptr if all the slots of this type are in use.
 	template <class Request>
 	Request *allocate()
 	{
-		return static_cast<Request *>(resource.allocate(sizeof(Request), alignof(Request)));
+		SlotLink *link = slab<Request>().free_list.pop();
+		if (!link)
+			return nullptr;
+		return &RequestSlot<Request>::from(link)->request;
 	}
 
 	template <class Request>
-	void deallocate(Request *ptr)
+	void deallocate(Request *request)
+	{
+		RequestSlot<Request> *slot = RequestSlot<Request>::from(request);
+		assert(slot >= slab<Request>().slots && slot < slab<Request>().slots + capacity_);
+		slab<Request>().free_list.push(&slot->link);
+	}
+
+	size_t capacity() const
 	{
-		resource.deallocate(static_cast<void *>(ptr), sizeof(Request), alignof(Request));
+		return capacity_;
 	}
 };
 
-} // namespace ringnet::uring
\ No newline at end of file
+} // namespace ringnet::uring
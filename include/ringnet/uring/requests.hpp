@@ -1,30 +1,68 @@
 #pragma once
 
+#include <cassert>
 #include <cstdint>
 #include <cstring>
 #include <iostream>
 #include <netdb.h>
 #include <span>
+#include <sys/socket.h>
+#include <sys/uio.h>
 
 #include <liburing.h>
 
+#include "ringnet/time/chronoUtils.hpp"
 #include "ringnet/traits/reinterpretable.hpp"
 
 namespace ringnet::uring
 {
 inline constexpr uint32_t HEADER_MAGIC_VALUE = 0xA1B2C3D4;
 
-enum class Operation : uint32_t {
-	ACCEPT = 0xA1A1A1A1,
-	CONNECT = 0xB2B2B2B2,
-	READ = 0xC3C3C3C3,
-	READ_MULTISHOT = 0xD4D4D4D4,
-	WRITE = 0xE5E5E5E5
+/// @brief Compact operation codes: they tag the completion user data (see UserData).
+enum class Operation : uint8_t {
+	ACCEPT = 1,
+	CONNECT,
+	READ,
+	READ_MULTISHOT,
+	READ_BUNDLE,
+	WRITE,
+	WRITE_FIXED,
+	WRITEV,
+	SEND_ZERO_COPY,
+	READ_PROVIDED_BUFFER,
+	MESSAGE,
+	TIMEOUT,
+	TIMEOUT_UPDATE,
+	CANCEL,
+	CLOSE,
+	/// @brief Completion posted to a ring by a message from another ring. Not associated to a pooled request.
+	WAKEUP,
+	/// @brief Timeout linked to a request. Not associated to a pooled request: its completion is ignored.
+	LINK_TIMEOUT,
 };
 
+/// @brief Request options, as a bit set.
+enum RequestFlag : uint8_t {
+	/// @brief The user data is a completion sink, notified directly (e.g. to resume a coroutine), instead of a
+	/// subscriber.
+	NOTIFY_SINK = 1 << 0,
+	/// @brief Submit the request right away, regardless of the batching policy of the loop.
+	URGENT = 1 << 1,
+	/// @brief The file descriptor of the request is an index in the fixed-file table of the ring
+	/// (IOSQE_FIXED_FILE), which saves the file lookup and reference counting on every operation.
+	FIXED_FILE = 1 << 2,
+	/// @brief Multi-shot request being cancelled to be armed again (e.g. in another buffer group): its cancellation
+	/// is not notified.
+	REARM = 1 << 3,
+};
+
+/// @brief Buffer group of a read request not assigned to any yet: the event loop assigns its default group.
+inline constexpr uint16_t NO_BUFFER_GROUP = -1;
+
 struct RequestHeader {
 	uint32_t magic = HEADER_MAGIC_VALUE;
 	Operation op;
+	uint8_t flags = 0;
 	void *user_data = nullptr;
 
 	explicit RequestHeader(Operation op_) : op(op_){};
@@ -33,13 +71,98 @@ struct RequestHeader {
 	{
 		return magic == HEADER_MAGIC_VALUE;
 	}
+	inline bool has(RequestFlag flag) const
+	{
+		return flags & flag;
+	}
 };
 static_assert(sizeof(RequestHeader) == 16);
 static_assert(ringnet::traits::is_safe_for_reinterpret_cast_v<RequestHeader>);
 
+/// @brief User data of a submission entry: the address of the issuing request, tagged with its operation and flags in
+/// the upper 16 bits (unused by user space addresses). A completion is dispatched on its tag alone: the request is only
+/// read when its content is needed, and the header magic is only checked in debug builds.
+struct UserData {
+	static constexpr unsigned ADDRESS_BITS = 48;
+	static constexpr uint64_t ADDRESS_MASK = (uint64_t{ 1 } << ADDRESS_BITS) - 1;
+	static constexpr unsigned FLAGS_SHIFT = ADDRESS_BITS;
+	static constexpr unsigned OPERATION_SHIFT = ADDRESS_BITS + 8;
+
+	uint64_t value = 0;
+
+	static UserData of(const RequestHeader &header)
+	{
+		const uint64_t address = reinterpret_cast<uintptr_t>(&header);
+		assert((address & ~ADDRESS_MASK) == 0 && "Request address does not fit in 48 bits");
+		return UserData{ (static_cast<uint64_t>(header.op) << OPERATION_SHIFT) |
+				 (static_cast<uint64_t>(header.flags) << FLAGS_SHIFT) | address };
+	}
+
+	/// @brief Tag of an entry not associated to any request.
+	static UserData of(Operation op)
+	{
+		return UserData{ static_cast<uint64_t>(op) << OPERATION_SHIFT };
+	}
+
+	/// @brief Tag of an entry issued on behalf of a request, for another operation (e.g. its linked timeout).
+	static UserData of(Operation op, const RequestHeader &header)
+	{
+		const uint64_t address = reinterpret_cast<uintptr_t>(&header);
+		assert((address & ~ADDRESS_MASK) == 0 && "Request address does not fit in 48 bits");
+		return UserData{ (static_cast<uint64_t>(op) << OPERATION_SHIFT) | address };
+	}
+
+	Operation op() const
+	{
+		return static_cast<Operation>(value >> OPERATION_SHIFT);
+	}
+
+	bool has(RequestFlag flag) const
+	{
+		return (value >> FLAGS_SHIFT) & flag;
+	}
+
+	RequestHeader *header() const
+	{
+		return reinterpret_cast<RequestHeader *>(static_cast<uintptr_t>(value & ADDRESS_MASK));
+	}
+
+	/// @brief Issuing request, whose type must match the operation.
+	template <class Request>
+	Request *request() const
+	{
+		return reinterpret_cast<Request *>(header());
+	}
+};
+
+/// @brief Optional deadline of a request, enforced by the kernel: a timeout (IORING_OP_LINK_TIMEOUT) is linked to the
+/// request, and cancels it once expired. The request then completes with -ECANCELED, and the timeout with -ETIME.
+/// Both complete in either order: the request is released once both did.
+struct LinkedTimeout {
+	bool enabled = false;
+	__kernel_timespec duration{};
+
+	/// @brief Completions handled so far, among the request and its timeout.
+	uint8_t completions = 0;
+	/// @brief Set once the timeout completed on expiry (-ETIME).
+	bool expired = false;
+	/// @brief The request was cancelled before the timeout completed: its error is notified once the timeout tells
+	/// whether the deadline expired.
+	bool cancellation_pending = false;
+
+	template <typename Rep, typename Period>
+	static LinkedTimeout after(const std::chrono::duration<Rep, Period> &duration)
+	{
+		return LinkedTimeout{ .enabled = true, .duration = time::chrono_utils::to_timespec(duration) };
+	}
+};
+
 struct AcceptRequest {
 	RequestHeader header{ Operation::ACCEPT };
 	int listening_socket_fd = -1;
+	/// @brief Install the accepted sockets in free slots of the fixed-file table of the ring, rather than in the
+	/// file descriptor table of the process: completions then hold slot indexes.
+	bool direct = false;
 };
 static_assert(ringnet::traits::is_safe_for_reinterpret_cast_v<AcceptRequest>);
 
@@ -48,6 +171,7 @@ struct ConnectRequest {
 	int socket_fd = -1;
 	const sockaddr *addr = nullptr;
 	socklen_t addrlen = 0;
+	LinkedTimeout timeout{};
 };
 static_assert(ringnet::traits::is_safe_for_reinterpret_cast_v<ConnectRequest>);
 
@@ -68,17 +192,141 @@ static_assert(ringnet::traits::is_safe_for_reinterpret_cast_v<ReadRequest>);
 struct MultiShotReadRequest {
 	RequestHeader header{ Operation::READ_MULTISHOT };
 	int fd = -1;
-	uint16_t buffer_group_id = -1;
+	uint16_t buffer_group_id = NO_BUFFER_GROUP;
+	/// @brief Buffer group to arm the request in again, once cancelled with the REARM flag.
+	uint16_t next_buffer_group_id = NO_BUFFER_GROUP;
 };
 static_assert(ringnet::traits::is_safe_for_reinterpret_cast_v<MultiShotReadRequest>);
 
+/// @brief Multi-shot receive of bundles (IORING_RECVSEND_BUNDLE): a single completion may cover several consecutive
+/// provided buffers, rather than a single one.
+struct BundleReadRequest {
+	RequestHeader header{ Operation::READ_BUNDLE };
+	int fd = -1;
+	uint16_t buffer_group_id = NO_BUFFER_GROUP;
+	/// @brief Buffer group to arm the request in again, once cancelled with the REARM flag.
+	uint16_t next_buffer_group_id = NO_BUFFER_GROUP;
+};
+static_assert(ringnet::traits::is_safe_for_reinterpret_cast_v<BundleReadRequest>);
+
+/// @brief Single-shot read request, using provided buffers. Needs to be renewed once completed.
+struct ProvidedBufferReadRequest {
+	RequestHeader header{ Operation::READ_PROVIDED_BUFFER };
+	int fd = -1;
+	uint16_t buffer_group_id = NO_BUFFER_GROUP;
+	LinkedTimeout timeout{};
+};
+static_assert(ringnet::traits::is_safe_for_reinterpret_cast_v<ProvidedBufferReadRequest>);
+
 struct WriteRequest {
 	RequestHeader header{ Operation::WRITE };
 	int fd = -1;
 	std::span<const std::byte> bytes_written{};
+	LinkedTimeout timeout{};
 };
 static_assert(ringnet::traits::is_safe_for_reinterpret_cast_v<WriteRequest>);
 
+/// @brief Write from a registered send buffer (IORING_OP_WRITE_FIXED). The buffer is given back to its pool once the
+/// write completes.
+struct WriteFixedRequest {
+	RequestHeader header{ Operation::WRITE_FIXED };
+	int fd = -1;
+	uint16_t buffer_index = 0;
+	std::span<const std::byte> bytes_written{};
+	LinkedTimeout timeout{};
+};
+static_assert(ringnet::traits::is_safe_for_reinterpret_cast_v<WriteFixedRequest>);
+
+/// @brief Vectored write (IORING_OP_SENDMSG): gathers several buffers into a single write, with a single completion.
+/// The buffers, as well as the array describing them, must outlive the completion.
+struct WritevRequest {
+	RequestHeader header{ Operation::WRITEV };
+	int fd = -1;
+	std::span<const iovec> buffers{};
+	/// @brief Flags of the sendmsg call (e.g. MSG_MORE).
+	int message_flags = 0;
+	/// @brief Filled in on preparation: lives as long as the request.
+	msghdr message{};
+	LinkedTimeout timeout{};
+};
+static_assert(ringnet::traits::is_safe_for_reinterpret_cast_v<WritevRequest>);
+
+/// @brief Zero-copy send (IORING_OP_SEND_ZC): the kernel sends straight from the user pages. Completes twice: first
+/// with the result of the send (flagged IORING_CQE_F_MORE), then with a notification (IORING_CQE_F_NOTIF) once the
+/// kernel no longer uses the bytes. The request lives until the notification.
+struct SendZeroCopyRequest {
+	RequestHeader header{ Operation::SEND_ZERO_COPY };
+	int fd = -1;
+	std::span<const std::byte> bytes_sent{};
+	/// @brief Result of the send, kept until the notification.
+	int result = 0;
+};
+static_assert(ringnet::traits::is_safe_for_reinterpret_cast_v<SendZeroCopyRequest>);
+
+/// @brief Message to another ring (IORING_OP_MSG_RING): the target ring gets a completion, holding the given data as
+/// user data.
+struct MessageRequest {
+	RequestHeader header{ Operation::MESSAGE };
+	int target_ring_fd = -1;
+	uint64_t data = 0;
+};
+static_assert(ringnet::traits::is_safe_for_reinterpret_cast_v<MessageRequest>);
+
+/// @brief Timeout (IORING_OP_TIMEOUT), completing with -ETIME once the deadline is reached. The deadline is absolute,
+/// on the monotonic clock (std::chrono::steady_clock).
+struct TimeoutRequest {
+	RequestHeader header{ Operation::TIMEOUT };
+	__kernel_timespec deadline{};
+};
+static_assert(ringnet::traits::is_safe_for_reinterpret_cast_v<TimeoutRequest>);
+
+/// @brief Move the deadline of an in-flight timeout request.
+struct TimeoutUpdateRequest {
+	RequestHeader header{ Operation::TIMEOUT_UPDATE };
+	const TimeoutRequest *timeout = nullptr;
+	__kernel_timespec deadline{};
+};
+static_assert(ringnet::traits::is_safe_for_reinterpret_cast_v<TimeoutUpdateRequest>);
+
+/// @brief Cancel all the in-flight requests on a file descriptor.
+struct CancelRequest {
+	RequestHeader header{ Operation::CANCEL };
+	int fd = -1;
+	/// @brief The owner of the file is going away: detach its requests (see SubmissionQueue::closeFile).
+	bool detach = false;
+	/// @brief If set, multi-shot read to cancel then arm again (REARM), if still armed once the cancellation is
+	/// prepared. Otherwise, all the requests on the file are cancelled.
+	RequestHeader *rearmed = nullptr;
+};
+static_assert(ringnet::traits::is_safe_for_reinterpret_cast_v<CancelRequest>);
+
+/// @brief Close a file descriptor, or free a slot of the fixed-file table (with the FIXED_FILE flag). Requests still in
+/// flight on the file keep it open until they complete.
+struct CloseRequest {
+	RequestHeader header{ Operation::CLOSE };
+	int fd = -1;
+};
+static_assert(ringnet::traits::is_safe_for_reinterpret_cast_v<CloseRequest>);
+
+/// @return The linked timeout of the request, null if its type has none.
+inline LinkedTimeout *linkedTimeoutOf(RequestHeader &header)
+{
+	switch (header.op) {
+	case Operation::CONNECT:
+		return &reinterpret_cast<ConnectRequest *>(&header)->timeout;
+	case Operation::READ_PROVIDED_BUFFER:
+		return &reinterpret_cast<ProvidedBufferReadRequest *>(&header)->timeout;
+	case Operation::WRITE:
+		return &reinterpret_cast<WriteRequest *>(&header)->timeout;
+	case Operation::WRITE_FIXED:
+		return &reinterpret_cast<WriteFixedRequest *>(&header)->timeout;
+	case Operation::WRITEV:
+		return &reinterpret_cast<WritevRequest *>(&header)->timeout;
+	default:
+		return nullptr;
+	}
+}
+
 inline std::ostream &operator<<(std::ostream &stream, const AcceptRequest &request)
 {
 	return (stream << "accept request for listening socket " << request.listening_socket_fd);
@@ -97,9 +345,57 @@ inline std::ostream &operator<<(std::ostream &stream, const MultiShotReadRequest
 	return (stream << "multi shot read request using buffer group ID " << request.buffer_group_id << " for socket "
 		       << request.fd);
 }
+inline std::ostream &operator<<(std::ostream &stream, const BundleReadRequest &request)
+{
+	return (stream << "multi shot bundle receive request using buffer group ID " << request.buffer_group_id
+		       << " for socket " << request.fd);
+}
+inline std::ostream &operator<<(std::ostream &stream, const ProvidedBufferReadRequest &request)
+{
+	return (stream << "single shot read request using buffer group ID " << request.buffer_group_id
+		       << " for socket " << request.fd);
+}
 inline std::ostream &operator<<(std::ostream &stream, const WriteRequest &request)
 {
 	return (stream << "write request of " << request.bytes_written.size() << " bytes for socket " << request.fd);
 }
+inline std::ostream &operator<<(std::ostream &stream, const WriteFixedRequest &request)
+{
+	return (stream << "write request of " << request.bytes_written.size() << " bytes from registered buffer "
+		       << request.buffer_index << " for socket " << request.fd);
+}
+inline std::ostream &operator<<(std::ostream &stream, const WritevRequest &request)
+{
+	return (stream << "vectored write request of " << request.buffers.size() << " buffers for socket "
+		       << request.fd);
+}
+inline std::ostream &operator<<(std::ostream &stream, const SendZeroCopyRequest &request)
+{
+	return (stream << "zero-copy send request of " << request.bytes_sent.size() << " bytes for socket "
+		       << request.fd);
+}
+inline std::ostream &operator<<(std::ostream &stream, const MessageRequest &request)
+{
+	return (stream << "message request to ring " << request.target_ring_fd);
+}
+inline std::ostream &operator<<(std::ostream &stream, const TimeoutRequest &request)
+{
+	return (stream << "timeout request until " << request.deadline.tv_sec << "s " << request.deadline.tv_nsec
+		       << "ns");
+}
+inline std::ostream &operator<<(std::ostream &stream, const TimeoutUpdateRequest &request)
+{
+	return (stream << "timeout update request until " << request.deadline.tv_sec << "s " << request.deadline.tv_nsec
+		       << "ns");
+}
+
+inline std::ostream &operator<<(std::ostream &stream, const CancelRequest &request)
+{
+	return (stream << "cancel request for socket " << request.fd);
+}
+inline std::ostream &operator<<(std::ostream &stream, const CloseRequest &request)
+{
+	return (stream << "close request for socket " << request.fd);
+}
 
 } // namespace ringnet::uring
\ No newline at end of file
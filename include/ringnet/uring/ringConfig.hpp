@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace ringnet::uring
+{
+
+/// @brief Kernel-side submission queue polling (IORING_SETUP_SQPOLL).
+/// A kernel thread polls the submission queue, so that submitting requests does not require any syscall while the
+/// thread is awake. It costs a core, busy polling on behalf of the ring.
+struct SubmissionPolling {
+	bool enabled = false;
+
+	/// @brief The kernel thread goes to sleep after this duration without any submission. Submitting again then
+	/// requires a syscall to wake it up.
+	std::chrono::milliseconds idle_timeout{ 1000 };
+
+	/// @brief If set, pin the kernel thread to this CPU (IORING_SETUP_SQ_AFF).
+	std::optional<uint32_t> cpu{};
+};
+
+/// @brief Send buffers registered with the ring (io_uring_register_buffers), leased with EventLoop::leaseSendBuffer.
+/// Writing from them (IORING_OP_WRITE_FIXED) saves the kernel mapping and pinning the user pages on every write.
+struct SendBuffers {
+	/// @brief Number of buffers, zero for none (at most 16384).
+	uint16_t count = 0;
+	uint32_t size = 4096;
+};
+
+/// @brief Group of buffers provided to the kernel for reads (io_uring_setup_buf_ring): the kernel picks one when data
+/// arrives, instead of each read holding its own buffer while waiting.
+struct ProvidedBuffers {
+	/// @brief Number of buffers, a power of two (at most 32768).
+	uint16_t count = 2048;
+	uint32_t size = 1024;
+
+	/// @brief Consume the buffers incrementally (IOU_PBUF_RING_INC, Linux 6.12): successive reads fill a buffer
+	/// one after the other, instead of each read taking a whole buffer. Large buffers (e.g. 64 KiB) then suit both
+	/// bulk transfers, with few completions, and small reads, without wasting memory. Whole buffers are used if the
+	/// kernel does not support it.
+	bool incremental = false;
+};
+
+/// @brief Setup options of the io_uring instance owned by an event loop. Default values match a plain
+/// io_uring_queue_init, without any flag.
+/// @note single_issuer, defer_taskrun and register_ring_fd bind the ring to the thread creating it: the loop must then
+/// be run (and requests submitted) from that same thread. ShardedEventLoop creates each loop on its own thread.
+struct RingConfig {
+	SubmissionPolling submission_polling{};
+
+	/// @brief Only a single thread submits requests (IORING_SETUP_SINGLE_ISSUER), which lets the kernel skip some
+	/// synchronization.
+	bool single_issuer = false;
+
+	/// @brief Run completion task work only when the loop asks for completions (IORING_SETUP_DEFER_TASKRUN), instead
+	/// of interrupting the thread as soon as a request completes. Implies single_issuer. Incompatible with
+	/// submission polling.
+	bool defer_taskrun = false;
+
+	/// @brief Do not interrupt the thread to run completion task work (IORING_SETUP_COOP_TASKRUN): it runs on the
+	/// next kernel entry. The kernel flags pending task work (IORING_SETUP_TASKRUN_FLAG), so that the loop can flush
+	/// it when it would not enter the kernel otherwise.
+	bool coop_taskrun = false;
+
+	/// @brief Completion queue size (IORING_SETUP_CQSIZE). Defaults to twice the submission queue size. Multi-shot
+	/// requests post many completions per submission: a larger completion queue avoids overflows under load.
+	std::optional<uint32_t> completion_queue_size{};
+
+	/// @brief Register the ring file descriptor (io_uring_register_ring_fd), saving the file lookup on every
+	/// io_uring_enter. The registration is specific to the calling thread.
+	bool register_ring_fd = false;
+
+	/// @brief Number of slots of the sparse fixed-file table registered with the ring
+	/// (io_uring_register_files_sparse), or zero for none. Sockets accepted directly into the table
+	/// (Acceptor::AcceptMode::DIRECT) are then used without any file lookup.
+	uint32_t fixed_files = 0;
+
+	SendBuffers send_buffers{};
+
+	/// @brief Groups of provided buffers, by increasing buffer size: the index of a group is its size class
+	/// (Connection::setBufferClass). Reads use the first one by default.
+	std::vector<ProvidedBuffers> provided_buffers{ ProvidedBuffers{} };
+};
+
+} // namespace ringnet::uring
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include <liburing.h>
+#include <sys/uio.h>
+
+#include "ringnet/uring/ringConfig.hpp"
+
+namespace ringnet::uring
+{
+
+class SendBufferPool;
+
+/// @brief Send buffer leased from the pool of a loop. Fill it, then hand it over to a write
+/// (Connection::asyncWrite): it goes back to the pool once the write completes. Given back right away if destroyed
+/// beforehand.
+/// @warning Lease, use and destroy it on the loop thread.
+class SendBuffer {
+    public:
+	SendBuffer() = default;
+	SendBuffer(const SendBuffer &) = delete;
+	SendBuffer &operator=(const SendBuffer &) = delete;
+
+	SendBuffer(SendBuffer &&other) : pool(std::exchange(other.pool, nullptr)), index_(other.index_)
+	{
+	}
+
+	SendBuffer &operator=(SendBuffer &&other)
+	{
+		std::swap(pool, other.pool);
+		std::swap(index_, other.index_);
+		return *this;
+	}
+
+	~SendBuffer();
+
+	/// @brief Whether a buffer was leased: the pool may be exhausted, or not set up.
+	explicit operator bool() const
+	{
+		return pool != nullptr;
+	}
+
+	/// @brief The whole registered buffer, to be filled before writing it.
+	std::span<std::byte> bytes() const;
+
+	/// @brief Index of the buffer among the buffers registered with the ring.
+	uint16_t index() const
+	{
+		return index_;
+	}
+
+	/// @brief Hand the buffer over to the write request it was submitted with: from now on, the pool gets it back
+	/// on completion.
+	void detach()
+	{
+		pool = nullptr;
+	}
+
+    private:
+	friend class SendBufferPool;
+	SendBuffer(SendBufferPool &pool_, uint16_t index) : pool(&pool_), index_(index)
+	{
+	}
+
+	SendBufferPool *pool = nullptr;
+	uint16_t index_ = 0;
+};
+
+/// @brief Fixed set of equally sized send buffers, allocated with the pool in a single page-aligned block, and
+/// registered with the ring (io_uring_register_buffers). The kernel maps and pins them once, rather than on every
+/// write.
+class SendBufferPool {
+	static constexpr size_t ALIGNMENT = 4096;
+
+	std::byte *memory = nullptr;
+	SendBuffers config{};
+	/// @brief Indexes of the buffers not leased, reused last in first out (their pages are still hot).
+	std::vector<uint16_t> free_indexes{};
+
+    public:
+	SendBufferPool() = default;
+	SendBufferPool(const SendBufferPool &) = delete;
+	SendBufferPool &operator=(const SendBufferPool &) = delete;
+
+	~SendBufferPool()
+	{
+		if (memory)
+			::operator delete(memory, std::align_val_t{ ALIGNMENT });
+	}
+
+	/// @brief Allocate the buffers, and register them with the ring. Nothing to do without any buffer.
+	/// @return The liburing error, if the registration failed. Zero otherwise.
+	int setup(io_uring &ring, const SendBuffers &config_)
+	{
+		if (config_.count == 0)
+			return 0;
+
+		config = config_;
+		memory = static_cast<std::byte *>(::operator new(capacity() * size(), std::align_val_t{ ALIGNMENT }));
+
+		std::vector<iovec> iovecs(capacity());
+		for (uint16_t index = 0; index < capacity(); index++)
+			iovecs[index] = iovec{ .iov_base = memory + index * size(), .iov_len = size() };
+		const int registered = io_uring_register_buffers(&ring, iovecs.data(), capacity());
+		if (registered < 0)
+			return registered;
+
+		// Pushed backwards: buffers are first leased in address order.
+		free_indexes.reserve(capacity());
+		for (size_t index = capacity(); index > 0; index--)
+			free_indexes.push_back(static_cast<uint16_t>(index - 1));
+		return 0;
+	}
+
+	/// @return A leased buffer, or an empty one if all the buffers are in use.
+	SendBuffer lease()
+	{
+		if (free_indexes.empty())
+			return SendBuffer{};
+		const uint16_t index = free_indexes.back();
+		free_indexes.pop_back();
+		return SendBuffer{ *this, index };
+	}
+
+	void release(uint16_t index)
+	{
+		assert(index < capacity());
+		free_indexes.push_back(index);
+	}
+
+	std::span<std::byte> bytes(uint16_t index) const
+	{
+		assert(index < capacity());
+		return std::span{ memory + index * size(), size() };
+	}
+
+	size_t capacity() const
+	{
+		return config.count;
+	}
+
+	size_t size() const
+	{
+		return config.size;
+	}
+
+	/// @brief Number of buffers currently available for lease.
+	size_t available() const
+	{
+		return free_indexes.size();
+	}
+};
+
+inline SendBuffer::~SendBuffer()
+{
+	if (pool)
+		pool->release(index_);
+}
+
+inline std::span<std::byte> SendBuffer::bytes() const
+{
+	assert(pool);
+	return pool->bytes(index_);
+}
+
+} // namespace ringnet::uring
@@ -1,105 +1,321 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <chrono>
 #include <cstdint>
+#include <limits>
 #include <memory>
-#include <mutex>
+#include <optional>
 #include <stdexcept>
 #include <string.h>
 #include <string>
+#include <unordered_map>
 
 #include <liburing.h>
 
+#include "ringnet/batchingPolicy.hpp"
 #include "ringnet/time/chronoUtils.hpp"
-#include "ringnet/uring/pendingRequests.hpp"
+#include "ringnet/uring/requestInbox.hpp"
 #include "ringnet/uring/requestPool.hpp"
 #include "ringnet/uring/requests.hpp"
+#include "ringnet/uring/ringConfig.hpp"
+#include "ringnet/uring/sendBufferPool.hpp"
 
 namespace ringnet::uring
 {
 
 enum AddRequestStatus { OK = 0, QUEUE_FULL };
-enum SubmitStatus : int { TIMEOUT = -ETIME, INTERRUPTED_SYSCALL = -EINTR, NOT_READY = -EAGAIN };
+enum SubmitStatus : int { TIMEOUT = -ETIME, INTERRUPTED_SYSCALL = -EINTR, NOT_READY = -EAGAIN, BUSY = -EBUSY };
 
 /// @brief Wrapper around the io_uring submission/completion queues.
 /// When the he caller adds requests, it goes through the following cycles:
-/// 1. Pushed to a waiting list of pending requests.
-/// 2. On next loop iteration, prepared (io_uring_prep*)
-/// 3. Submitted, by batch (io_uring_submit*)
+/// 1. Pushed to a waiting list of pending requests (from any thread).
+/// 2. On next loop iteration, prepared (io_uring_prep*), in the order they were pushed
+/// 3. Submitted, by batch (io_uring_submit*), as allowed by the batching policy
 /// 4. The corresponding completion entry is processed (io_uring_for_each_cqe)
+/// With submission polling enabled, step 3 only enters the kernel when the polling thread went to sleep.
 class SubmissionQueue {
-	RequestPool request_pool{};
-	PendingRequests<AcceptRequest, ConnectRequest, ReadRequest, MultiShotReadRequest, WriteRequest>
-		pending_requests{};
+	RequestPool<AcceptRequest, ConnectRequest, ReadRequest, MultiShotReadRequest, BundleReadRequest,
+		    ProvidedBufferReadRequest, WriteRequest, WriteFixedRequest, WritevRequest, SendZeroCopyRequest,
+		    MessageRequest, TimeoutRequest, TimeoutUpdateRequest, CancelRequest, CloseRequest>
+		request_pool;
+	RequestInbox pending_requests{};
+	/// @brief Popped request that could not get a submission entry: prepared first on next submission, ahead of the
+	/// pending requests.
+	SlotLink *unprepared_request = nullptr;
+
+	/// @brief Armed multi-shot requests (accept, read), by file (see fileKey). A multi-shot request stays armed
+	/// until a completion without IORING_CQE_F_MORE: its slot is then either re-armed or given back to the pool.
+	std::unordered_multimap<uint64_t, RequestHeader *> active_multishots{};
+
+	/// @brief Single-shot requests in flight notifying a subscriber, by file (see fileKey): the subscriber usually
+	/// goes away with the owner of the file, which cancels it. Requests notifying a sink are left to the sink
+	/// (e.g. a coroutine is resumed with the cancellation).
+	std::unordered_multimap<uint64_t, RequestHeader *> subscribed_requests{};
+
+	/// @brief Features supported by the kernel, as reported on setup.
+	uint32_t features = 0;
+
+	/// @brief Size of the registered fixed-file table.
+	uint32_t fixed_files_count = 0;
+
+	/// @brief Registered send buffers. A buffer written by a request is given back once the request is released.
+	SendBufferPool send_buffers{};
 
     public:
-	explicit SubmissionQueue(size_t queue_size);
+	explicit SubmissionQueue(size_t queue_size, const RingConfig &config = {});
 	~SubmissionQueue();
 
+	SubmissionQueue(const SubmissionQueue &) = delete;
+	SubmissionQueue &operator=(const SubmissionQueue &) = delete;
+
+	/// @return The pooled copy of the request, valid until its completion is processed. Null if as many requests
+	/// of this type are already in flight as the completion queue has entries: the request is then dropped.
+	/// @note Thread-safe.
 	template <class Request>
-	void push(Request &&request)
+	std::decay_t<Request> *push(Request &&request)
 	{
-		Request *ptr = request_pool.allocate<Request>();
-		*ptr = std::move(request);
-
-		std::lock_guard<std::mutex> lock_guard(pending_requests_mutex);
-		pending_requests.push(ptr);
+		using Type = std::decay_t<Request>;
+		Type *ptr = request_pool.allocate<Type>();
+		if (!ptr)
+			return nullptr;
+		*ptr = std::forward<Request>(request);
+		pending_requests.push(&RequestSlot<Type>::from(ptr)->link);
+		return ptr;
 	}
 
-	void cancel(int fd);
+	/// @brief Cancel all the in-flight requests on the file descriptor, once the requests pushed so far are
+	/// submitted. Their cancellation is notified.
+	/// @return Whether the cancellation could be queued.
+	bool cancel(int fd);
+
+	/// @brief Cancel all the in-flight requests on the file descriptor, then close it once they are cancelled. Its
+	/// multi-shot requests, and its single-shot requests notifying a subscriber, are detached right away: their
+	/// remaining completions, if any, are not notified, even those already in the completion queue.
+	/// @return Whether both the cancellation and the closure could be queued.
+	/// @warning Not thread-safe: call from the thread running the completions.
+	bool closeFile(int fd);
+
+	/// @brief Cancel all the in-flight requests on the fixed file, then free its slot of the fixed-file table. Its
+	/// requests are detached, as with closeFile.
+	/// @return Whether both the cancellation and the closure could be queued.
+	/// @warning Not thread-safe: call from the thread running the completions.
+	bool closeFixedFile(int index);
+
+	/// @brief Move the multi-shot reads armed on the file to another buffer group: each one is cancelled, then
+	/// armed again in the new group once its cancellation completes. A read terminated in the meantime (e.g. out
+	/// of buffers) is armed again in the new group as well, and no longer cancelled.
+	/// @param flags Flags of the requests on the file (FIXED_FILE).
+	/// @return The number of reads moved.
+	/// @warning Not thread-safe: call from the thread running the completions.
+	size_t switchBufferGroup(int fd, uint8_t flags, uint16_t buffer_group_id);
+
+	/// @brief Whether the kernel supports the feature (IORING_FEAT_*).
+	bool hasFeature(uint32_t feature) const;
+
+	/// @brief Number of slots of the fixed-file table, zero if none is registered.
+	uint32_t fixedFilesCount() const;
+
+	/// @return A registered send buffer, or an empty one if none is available.
+	/// @warning Not thread-safe: call from the thread running the completions.
+	SendBuffer leaseSendBuffer();
 
-	SubmitStatus submit(std::chrono::milliseconds timeout = {});
+	const SendBufferPool &sendBuffers() const;
+
+	/// @brief Prepare pending requests, then submit the prepared ones if the batching policy allows it.
+	/// @param timeout If positive, and no completion is available yet, wait up to this duration for one (within the
+	/// same syscall as the submission when possible). Otherwise, return right away.
+	/// @return The number of submitted entries, NOT_READY if there was nothing to submit, or an error.
+	SubmitStatus submit(std::chrono::nanoseconds timeout = {});
+
+	/// @brief Wait up to the given duration for a completion, without submitting anything. Shortened to the delay
+	/// left to the prepared requests, as set by the batching policy.
+	SubmitStatus wait(std::chrono::nanoseconds timeout);
+
+	void setBatchingPolicy(const BatchingPolicy &policy);
+
+	/// @brief Number of multi-shot requests armed in the kernel.
+	size_t activeMultishotsCount() const;
+
+	/// @brief Number of io_uring_enter calls submitting entries, and number of entries they submitted.
+	uint64_t submissionsCount() const;
+	uint64_t submittedEntriesCount() const;
+
+	/// @brief Whether completions are available, without entering the kernel.
+	bool hasCompletions() const;
+
+	/// @brief Whether completions are available, after flushing deferred or pending task work (which may enter the
+	/// kernel, without blocking).
+	bool pollCompletions();
 
 	static inline constexpr bool shouldContinueSubmitting(SubmitStatus status)
 	{
-		return status == TIMEOUT || status == INTERRUPTED_SYSCALL || status == NOT_READY;
+		// Busy: completions must be reaped before submitting again.
+		return status == TIMEOUT || status == INTERRUPTED_SYSCALL || status == NOT_READY || status == BUSY;
 	}
 
+	/// @brief Once the completion queue is full, the kernel holds completions back (IORING_FEAT_NODROP), until
+	/// asked for events. Flush them into the completion queue.
+	/// @return Whether completions had overflowed.
+	bool flushOverflowedCompletions();
+
+	/// @brief Dispatch the available completions, then give their entries back to the completion queue. Completions
+	/// are peeked by batches (io_uring_peek_batch_cqe), and the queue head is advanced once per batch.
+	/// @param budget Maximum number of completions to dispatch: the remaining ones are left for the next call.
+	/// @return The number of dispatched completions.
 	template <class UnaryFunc>
-	void forEachCompletion(UnaryFunc &&function);
+	size_t forEachCompletion(UnaryFunc &&function, size_t budget = std::numeric_limits<size_t>::max());
 
 	io_uring &getRing();
 
     private:
-	/// @brief Prepare all pending requests, then clear the pending requests queue.
+	/// @brief Prepare all pending requests, popping them from the pending requests queue. Stops at the first
+	/// request without room in the submission queue: it stays queued, and the next requests remain pending.
 	/// @return The number of prepared requests.
 	size_t preparePendingRequests();
 
+	AddRequestStatus prepare(RequestHeader *header);
+
 	AddRequestStatus prepare(AcceptRequest *request);
 	AddRequestStatus prepare(ConnectRequest *request);
 	AddRequestStatus prepare(ReadRequest *request);
 	AddRequestStatus prepare(MultiShotReadRequest *request);
+	AddRequestStatus prepare(BundleReadRequest *request);
+	AddRequestStatus prepare(ProvidedBufferReadRequest *request);
 	AddRequestStatus prepare(WriteRequest *request);
-	std::mutex pending_requests_mutex{};
+	AddRequestStatus prepare(WriteFixedRequest *request);
+	AddRequestStatus prepare(WritevRequest *request);
+	AddRequestStatus prepare(SendZeroCopyRequest *request);
+	AddRequestStatus prepare(MessageRequest *request);
+	AddRequestStatus prepare(TimeoutRequest *request);
+	AddRequestStatus prepare(TimeoutUpdateRequest *request);
+	AddRequestStatus prepare(CancelRequest *request);
+	AddRequestStatus prepare(CloseRequest *request);
+
+	/// @brief Let the kernel look the file of the request up in the fixed-file table, if flagged so. Called once
+	/// the entry is prepared: io_uring_prep_* reset its flags.
+	static void setFileFlags(io_uring_sqe *sqe, const RequestHeader &header);
+
+	/// @brief Whether the multi-shot request is armed on the file, as opposed to terminated, or pending.
+	bool isArmed(int fd, const RequestHeader &header) const;
+
+	/// @brief Detach the multi-shot requests armed on the file, and the single-shot requests in flight notifying a
+	/// subscriber, from their subscriber or sink.
+	/// @param file_header Header holding the flags of the requests on the file (FIXED_FILE).
+	void detachRequests(int fd, const RequestHeader &file_header);
+
+	/// @brief Track the prepared single-shot request if it notifies a subscriber (see subscribed_requests).
+	void trackSubscribed(int fd, RequestHeader &header);
+
+	/// @brief Cancel all the in-flight requests on the file, then close it.
+	/// @param flags FIXED_FILE for a slot of the fixed-file table.
+	bool cancelThenClose(int fd, uint8_t flags);
+
+	/// @brief Key of a file in active_multishots and subscribed_requests: file descriptors and fixed-file indexes
+	/// may overlap.
+	static uint64_t fileKey(int fd, const RequestHeader &header);
+
+	template <class Request>
+	static int fileOf(const Request &request);
 
 	io_uring ring{};
 
+	using Clock = std::chrono::steady_clock;
+	BatchingPolicy batching_policy{};
+	/// @brief Preparation time of the oldest request not submitted yet.
+	Clock::time_point oldest_unsubmitted{};
+	bool urgent_unsubmitted = false;
+	uint64_t submissions_count = 0;
+	uint64_t submitted_entries_count = 0;
+
+	/// @brief Whether the prepared requests should be submitted now, according to the batching policy.
+	bool shouldSubmit(unsigned prepared_count) const;
+	/// @brief Time left before the prepared requests must be submitted, if any is prepared.
+	std::optional<std::chrono::nanoseconds> batchDelayLeft() const;
+	/// @brief Account for the submission of the currently prepared entries, right before submitting them.
+	void onSubmission();
+
+	bool isPolled() const;
+
+	/// @brief When nothing was submitted, the loop does not enter the kernel: make sure that completions whose task
+	/// work is deferred (IORING_SETUP_DEFER_TASKRUN) or pending (IORING_SETUP_COOP_TASKRUN) are still posted. Only
+	/// enters the kernel when it flags pending task work (IORING_SQ_TASKRUN) or overflowed completions.
+	void flushTaskWork();
+
 	/// @brief Get a new entry from the submission queue. If fails the first time, try to get room in the queue by
 	/// submitting pending entries.
 	/// @return A new submission entry if either first or second try succeeded. Otherwise, nullptr.
 	/// @note The caller should check for nullptr.
 	io_uring_sqe *getNewSubmissionQueueEntry();
 
+	/// @brief Make sure the submission queue has room for the given number of entries, submitting pending entries
+	/// if needed. Used before preparing linked entries, which must not be split across submissions.
+	/// @return Whether there is enough room.
+	bool reserveSubmissionQueueEntries(unsigned count);
+
+	/// @brief Number of entries taken by a request: one, plus its linked timeout if any.
+	static unsigned entriesCount(const LinkedTimeout &timeout);
+
+	/// @brief If enabled, link a timeout to the request whose entry was just prepared. Room must have been reserved
+	/// for it beforehand.
+	void linkTimeout(io_uring_sqe *sqe, const RequestHeader &header, LinkedTimeout &timeout);
+
 	void release(io_uring_cqe *cqe);
 
+	/// @brief Give the slot of a request back to the pool, once both the request and its linked timeout (if any)
+	/// completed.
+	template <class Request>
+	void releaseLinked(Request *request);
+	void releaseLinkedTimeout(RequestHeader *header);
+
+	/// @brief Give the slot of a single-shot request back to the pool, untracking it first (see trackSubscribed).
+	template <class Request>
+	void releaseSubscribed(Request *request);
+
+	/// @brief Handle the completion of a multi-shot request: once terminated by the kernel, re-arm it if the cause
+	/// is transient, or give its slot back to the pool.
+	template <class Request>
+	void releaseMultishot(io_uring_cqe *cqe, Request *request);
+
+	/// @brief Cancel the multi-shot read, to arm it again in another buffer group.
+	template <class Request>
+	bool switchBufferGroup(Request *request, uint16_t buffer_group_id);
+
+	/// @brief Whether a multi-shot request terminated by this completion should be armed again: the kernel ran out
+	/// of provided buffers, or stopped the request while it succeeded (e.g. on completion queue overflow).
+	static bool isTransientTermination(const io_uring_cqe *cqe, Operation op);
+
 	static void throwOnError(int liburing_error, std::string_view message);
+
+	/// @brief Capacity of the request pool, per request type: the size of the completion queue, as set up by the
+	/// kernel (rounded up to a power of two).
+	static size_t requestPoolCapacity(size_t queue_size, const RingConfig &config);
 };
 
 // Template function definitions must remain in header
 template <class UnaryFunc>
-void SubmissionQueue::forEachCompletion(UnaryFunc &&function)
+size_t SubmissionQueue::forEachCompletion(UnaryFunc &&function, size_t budget)
 {
-	io_uring_cqe *cqe;
-	uint head = 0;
-	uint processed = 0;
-	io_uring_for_each_cqe(&ring, head, cqe)
-	{
-		++processed;
-		function(cqe);
-		release(cqe);
+	static constexpr size_t BATCH_SIZE = 64;
+	std::array<io_uring_cqe *, BATCH_SIZE> batch;
+
+	size_t processed = 0;
+	while (processed < budget) {
+		const unsigned count = io_uring_peek_batch_cqe(
+			&ring, batch.data(), static_cast<unsigned>(std::min(budget - processed, BATCH_SIZE)));
+		for (unsigned index = 0; index < count; index++) {
+			function(batch[index]);
+			release(batch[index]);
+		}
+		io_uring_cq_advance(&ring, count);
+		processed += count;
+
+		// The queue was drained.
+		if (count < BATCH_SIZE)
+			break;
 	}
-	if (processed)
-		io_uring_cq_advance(&ring, processed);
+	return processed;
 }
 
 } // namespace ringnet::uring
@@ -1,58 +1,199 @@
 #include <cassert>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
 #include "ringnet/eventLoop.hpp"
 
 namespace ringnet
 {
-EventLoop::EventLoop(size_t request_queue_size)
-	: submission_queue(request_queue_size), buffer_ring(submission_queue.getRing())
+EventLoop::EventLoop(size_t request_queue_size, const uring::RingConfig &ring_config)
+	: submission_queue(request_queue_size, ring_config)
 {
-	MessagedStatus status = buffer_ring.setupBuffers(buffers);
-	if (!status)
-		error_handler.handle(status.what());
+	buffer_groups.reserve(ring_config.provided_buffers.size());
+	for (const uring::ProvidedBuffers &provided : ring_config.provided_buffers) {
+		const uint16_t group_id = static_cast<uint16_t>(buffer_groups.size() + 1);
+		auto &group = buffer_groups.emplace_back(
+			std::make_unique<BufferGroup>(submission_queue.getRing(), group_id, provided));
+		MessagedStatus status = group->ring.setupBuffers(std::span{ group->buffers }, provided.incremental);
+		if (!status)
+			error_handler.handle(status.what());
+	}
+
+	wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (wakeup_fd < 0) {
+		error_handler.handle("Error: Could not create the wakeup event file descriptor");
+		return;
+	}
+	wakeup_subscriber.on<events::ReadEvent>([this](events::ReadEvent &&) { armWakeup(); });
+	wakeup_subscriber.on<events::ErrorEvent>([this](events::ErrorEvent &&error) {
+		// Posted tasks are still run, once the loop wakes up for another reason.
+		if (error.error_code != ECANCELED)
+			error_handler.handle(Error{ error });
+	});
+	armWakeup();
+}
+
+EventLoop::BufferGroup::BufferGroup(io_uring &io_ring, uint16_t group_id, const uring::ProvidedBuffers &config)
+	: memory(std::make_unique<std::byte[]>(size_t{ config.count } * config.size)), ring(io_ring, group_id)
+{
+	buffers.reserve(config.count);
+	for (size_t index = 0; index < config.count; index++)
+		buffers.push_back(std::span{ memory.get() + index * config.size, config.size });
+}
+
+void EventLoop::armWakeup()
+{
+	uring::ReadRequest request{ .fd = wakeup_fd,
+				    .reception_buffer = std::as_writable_bytes(std::span{ &wakeup_counter, 1 }) };
+	// Until submitted, posting a task cannot wake the loop up.
+	request.header.flags = uring::URGENT;
+	if (add(std::move(request), &wakeup_subscriber) == uring::QUEUE_FULL)
+		error_handler.handle("Error: Could not arm the wakeup event file descriptor");
+}
+
+void EventLoop::signal()
+{
+	if (wakeup_fd < 0)
+		return;
+	const uint64_t increment = 1;
+	[[maybe_unused]] ssize_t written = ::write(wakeup_fd, &increment, sizeof(increment));
+}
+
+void EventLoop::runPostedTasks()
+{
+	// Reset before draining: a task posted from now on needs another wakeup, while one posted earlier is drained.
+	wakeup_pending = false;
+	{
+		std::lock_guard<std::mutex> lock{ posted_tasks_mutex };
+		std::swap(posted_tasks, running_tasks);
+	}
+	for (PostedTask &task : running_tasks)
+		task();
+	running_tasks.clear();
+}
+
+void EventLoop::scheduleFlush(FlushSink &sink)
+{
+	if (sink.scheduled)
+		return;
+	sink.scheduled = true;
+	scheduled_flushes.push_back(&sink);
+}
+
+void EventLoop::cancelFlush(FlushSink &sink)
+{
+	if (!sink.scheduled)
+		return;
+	sink.scheduled = false;
+	std::erase(scheduled_flushes, &sink);
+}
+
+void EventLoop::runFlushes()
+{
+	std::swap(scheduled_flushes, running_flushes);
+	for (FlushSink *sink : running_flushes) {
+		sink->scheduled = false;
+		sink->flush(*sink);
+	}
+	running_flushes.clear();
 }
 
 void EventLoop::cancel(int socket_fd)
 {
-	submission_queue.cancel(socket_fd);
+	if (!submission_queue.cancel(socket_fd))
+		error_handler.handle("Error: Could not queue the cancellation of socket requests");
+}
+
+void EventLoop::closeFile(int socket_fd)
+{
+	if (submission_queue.closeFile(socket_fd))
+		return;
+	error_handler.handle("Error: Could not queue the closure of a socket");
+	::close(socket_fd);
+}
+
+void EventLoop::closeFixedFile(int index)
+{
+	if (!submission_queue.closeFixedFile(index))
+		error_handler.handle("Error: Could not queue the closure of a fixed file");
+}
+
+uint32_t EventLoop::fixedFilesCount() const
+{
+	return submission_queue.fixedFilesCount();
+}
+
+uring::SendBuffer EventLoop::leaseSendBuffer()
+{
+	return submission_queue.leaseSendBuffer();
 }
 
 void EventLoop::run()
 {
 	using namespace ringnet::uring;
 
+	coro::FramePool::Scope frame_scope{ frame_pool };
 	while (should_continue) {
-		SubmitStatus submit_status = submission_queue.submit(std::chrono::milliseconds(100));
+		runFlushes();
+		SubmitStatus submit_status = submitThenIdle();
+		++statistics_.iterations;
+		statistics_.submissions = submission_queue.submissionsCount();
+		statistics_.submitted_entries = submission_queue.submittedEntriesCount();
+		statistics_.active_multishots = submission_queue.activeMultishotsCount();
 
-		submission_queue.forEachCompletion([this](Completion cqe) {
-			if (!cqe->user_data) {
+		statistics_.completions += submission_queue.forEachCompletion([this](Completion cqe) {
+			// Dispatched on the tag: the request is only read when its content is needed.
+			const UserData user_data{ cqe->user_data };
+			if (handleInternalCompletion(cqe, user_data))
+				return;
+
+			const RequestHeader *header = user_data.header();
+			assert(!header || header->valid());
+			if (!header) {
 				error_handler.handle("Error: Malformed completion queue entry");
 				return;
 			}
 
-			const uring::RequestHeader *header = reinterpret_cast<const RequestHeader *>(cqe->user_data);
-			if (!header->valid()) {
-				error_handler.handle("Error: Invalid request header");
+			// Detached from its cancelled owner: only give the selected buffers back, if any.
+			if (!header->user_data) {
+				if (auto *buffer_ring = providedBuffers(user_data))
+					buffer_ring->release(cqe);
 				return;
 			}
 
-			Subscriber *subscriber = getAssociatedSubscriber(header);
+			// The multi-shot request is armed again once buffers are given back: not an error.
+			if (cqe->res == -ENOBUFS && isMultishot(user_data))
+				return;
+			// Cancelled to be armed again, in another buffer group.
+			if (cqe->res == -ECANCELED && header->has(uring::REARM))
+				return;
 
-			if (!subscriber) {
-				error_handler.handle("Error: No subscriber");
+			if (user_data.op() == Operation::SEND_ZERO_COPY) {
+				handleZeroCopySend(cqe, user_data);
 				return;
 			}
 
 			if (cqe->res < 0) {
 				/// @todo Provide this info in the error event instead, letting the subscriber log it.
 				logIssuingRequest(cqe);
-				subscriber->handle(events::ErrorEvent{ .error_code = -(cqe->res) });
+				int error_code = -(cqe->res);
+				// Cancelled by its linked timeout, or otherwise: only the timeout completion tells.
+				if (cqe->res == -ECANCELED && hasDeadline(user_data)) {
+					uring::LinkedTimeout *timeout = uring::linkedTimeoutOf(*user_data.header());
+					if (timeout->completions == 0) {
+						timeout->cancellation_pending = true;
+						return;
+					}
+					error_code = timeout->expired ? ETIMEDOUT : ECANCELED;
+				}
+				notify(user_data, events::ErrorEvent{ .error_code = error_code });
 				return;
 			}
 
-			switch (header->op) {
+			switch (user_data.op()) {
 			case Operation::ACCEPT: {
-				subscriber->handle(events::AcceptEvent{ .client_fd = cqe->res });
+				const bool direct = user_data.request<uring::AcceptRequest>()->direct;
+				notify(user_data, events::AcceptEvent{ .client_fd = cqe->res, .fixed_file = direct });
 			} break;
 			case Operation::READ: {
 				auto request = getIssuingRequest<uring::ReadRequest>(cqe);
@@ -60,39 +201,60 @@ void EventLoop::run()
 				// The result holds the number of bytes read.
 				assert(static_cast<int>(request->reception_buffer.size()) >= cqe->res);
 				assert(cqe->res >= 0);
-				subscriber->handle(events::ReadEvent{
+				notify(user_data, events::ReadEvent{
 					.fd = request->fd,
 					.bytes_read = request->reception_buffer.subspan(0, cqe->res) });
 
 			} break;
 			case Operation::READ_MULTISHOT: {
 				auto request = getIssuingRequest<uring::MultiShotReadRequest>(cqe);
-				// The result holds the number of bytes read.
-				assert(cqe->res >= 0);
-
-				auto buffer_view = buffer_ring.get(cqe);
-				if (!buffer_view.has_value()) {
-					error_handler.handle("Error: Invalid buffer ID");
-					break;
-				}
-				subscriber->handle(events::ReadEvent{
-					.fd = request->fd, .bytes_read = buffer_view->subspan(0, cqe->res) });
-				buffer_ring.release(cqe);
+				handleProvidedBufferRead(cqe, request->fd, user_data);
+			} break;
+			case Operation::READ_BUNDLE: {
+				auto request = getIssuingRequest<uring::BundleReadRequest>(cqe);
+				handleBundleRead(cqe, request->fd, user_data);
+			} break;
+			case Operation::READ_PROVIDED_BUFFER: {
+				auto request = getIssuingRequest<uring::ProvidedBufferReadRequest>(cqe);
+				handleProvidedBufferRead(cqe, request->fd, user_data);
 			} break;
 			case Operation::WRITE: {
 				auto request = getIssuingRequest<uring::WriteRequest>(cqe);
+				// The result holds the number of bytes written: the caller resubmits the rest, if any.
+				assert(static_cast<int>(request->bytes_written.size()) >= cqe->res);
+				notify(user_data, events::WriteEvent{
+					.fd = request->fd,
+					.bytes_written = request->bytes_written.subspan(0, cqe->res) });
+			} break;
+			case Operation::WRITE_FIXED: {
+				// The buffer goes back to the pool once the completion is dispatched.
+				auto request = getIssuingRequest<uring::WriteFixedRequest>(cqe);
 				assert(static_cast<int>(request->bytes_written.size()) >= cqe->res);
-				subscriber->handle(
-					events::WriteEvent{ .fd = cqe->res, .bytes_written = request->bytes_written });
+				notify(user_data, events::WriteEvent{
+					.fd = request->fd,
+					.bytes_written = request->bytes_written.subspan(0, cqe->res) });
+			} break;
+			case Operation::WRITEV: {
+				auto request = getIssuingRequest<uring::WritevRequest>(cqe);
+				notify(user_data, events::WriteEvent{ .fd = request->fd,
+								      .buffers = request->buffers,
+								      .vectored_size = static_cast<size_t>(cqe->res) });
 			} break;
 			case Operation::CONNECT: {
-				subscriber->handle(events::ConnectEvent{});
+				notify(user_data, events::ConnectEvent{});
 			} break;
 			default:
 				error_handler.handle("Error: Malformed completion queue entry");
 				break;
 			}
-		});
+		}, completion_budget);
+
+		// Completions held back by the kernel are handled on next iteration.
+		if (submission_queue.flushOverflowedCompletions())
+			++statistics_.completion_queue_overflows;
+
+		runPostedTasks();
+		runTimers();
 
 		if (submission_queue.shouldContinueSubmitting(submit_status))
 			continue;
@@ -103,19 +265,310 @@ void EventLoop::run()
 	}
 }
 
-inline Subscriber *EventLoop::getAssociatedSubscriber(const uring::RequestHeader *header)
+void EventLoop::spawn(coro::Task<void> task)
+{
+	runDetached(std::move(task));
+}
+
+coro::Detached EventLoop::runDetached(coro::Task<void> task)
+{
+	try {
+		co_await task;
+	} catch (const std::exception &exception) {
+		error_handler.handle(exception.what());
+	}
+}
+
+void EventLoop::handleProvidedBufferRead(Completion cqe, int fd, uring::UserData user_data)
+{
+	// The result holds the number of bytes read.
+	assert(cqe->res >= 0);
+
+	// No buffer is selected when reaching the end of file.
+	if (cqe->res == 0) {
+		notify(user_data, events::ReadEvent{ .fd = fd, .bytes_read = {} });
+		return;
+	}
+
+	auto *buffer_ring = providedBuffers(user_data);
+	auto buffer_view = buffer_ring ? buffer_ring->get(cqe) : std::nullopt;
+	if (!buffer_view.has_value()) {
+		error_handler.handle("Error: Invalid buffer ID");
+		return;
+	}
+	notify(user_data, events::ReadEvent{ .fd = fd, .bytes_read = buffer_view->subspan(0, cqe->res) });
+	buffer_ring->release(cqe);
+}
+
+void EventLoop::handleZeroCopySend(Completion cqe, uring::UserData user_data)
+{
+	auto request = user_data.request<uring::SendZeroCopyRequest>();
+	if (!(cqe->flags & IORING_CQE_F_NOTIF)) {
+		request->result = cqe->res;
+		if (cqe->flags & IORING_CQE_F_MORE)
+			return;
+	}
+
+	if (request->result < 0) {
+		logIssuingRequest(cqe);
+		notify(user_data, events::ErrorEvent{ .error_code = -(request->result) });
+		return;
+	}
+	assert(static_cast<int>(request->bytes_sent.size()) >= request->result);
+	notify(user_data, events::WriteEvent{ .fd = request->fd,
+					      .bytes_written = request->bytes_sent.subspan(0, request->result) });
+}
+
+void EventLoop::handleBundleRead(Completion cqe, int fd, uring::UserData user_data)
+{
+	// The result holds the number of bytes read, across the buffers.
+	assert(cqe->res >= 0);
+
+	// No buffer is selected when reaching the end of file.
+	if (cqe->res == 0) {
+		notify(user_data, events::ReadEvent{ .fd = fd, .bytes_read = {} });
+		return;
+	}
+
+	auto *buffer_ring = providedBuffers(user_data);
+	if (!buffer_ring || !buffer_ring->getBundle(cqe, bundle_views)) {
+		error_handler.handle("Error: Invalid buffer ID");
+		return;
+	}
+	notify(user_data, events::ReadEvent{ .fd = fd, .bytes_read = bundle_views.front(), .buffers = bundle_views });
+	buffer_ring->release(cqe);
+}
+
+uring::BufferRing<EventLoop::Buffer> *EventLoop::providedBuffers(uring::UserData user_data)
+{
+	using namespace ringnet::uring;
+
+	uint16_t group_id = NO_BUFFER_GROUP;
+	switch (user_data.op()) {
+	case Operation::READ_MULTISHOT:
+		group_id = user_data.request<MultiShotReadRequest>()->buffer_group_id;
+		break;
+	case Operation::READ_BUNDLE:
+		group_id = user_data.request<BundleReadRequest>()->buffer_group_id;
+		break;
+	case Operation::READ_PROVIDED_BUFFER:
+		group_id = user_data.request<ProvidedBufferReadRequest>()->buffer_group_id;
+		break;
+	default:
+		return nullptr;
+	}
+	if (group_id == 0 || group_id > buffer_groups.size())
+		return nullptr;
+	return &buffer_groups[group_id - 1]->ring;
+}
+
+size_t EventLoop::bufferClassesCount() const
+{
+	return buffer_groups.size();
+}
+
+size_t EventLoop::bufferSize(size_t size_class) const
+{
+	assert(size_class < buffer_groups.size());
+	return buffer_groups[size_class]->ring.bufferSize();
+}
+
+uint16_t EventLoop::bufferGroupId(size_t size_class) const
+{
+	assert(size_class < buffer_groups.size());
+	return buffer_groups[size_class]->ring.groupId();
+}
+
+void EventLoop::switchBufferClass(int socket_fd, uint8_t flags, size_t size_class)
+{
+	submission_queue.switchBufferGroup(socket_fd, flags, bufferGroupId(size_class));
+}
+
+bool EventLoop::incrementalBuffers(size_t size_class) const
+{
+	assert(size_class < buffer_groups.size());
+	return buffer_groups[size_class]->ring.incremental();
+}
+
+bool EventLoop::supportsReceiveBundles() const
+{
+	return submission_queue.hasFeature(IORING_FEAT_RECVSEND_BUNDLE);
+}
+
+bool EventLoop::isMultishot(uring::UserData user_data)
+{
+	return user_data.op() == uring::Operation::ACCEPT || user_data.op() == uring::Operation::READ_MULTISHOT ||
+	       user_data.op() == uring::Operation::READ_BUNDLE;
+}
+
+bool EventLoop::hasDeadline(uring::UserData user_data)
+{
+	using namespace ringnet::uring;
+
+	const LinkedTimeout *timeout = linkedTimeoutOf(*user_data.header());
+	return timeout && timeout->enabled;
+}
+
+bool EventLoop::handleInternalCompletion(Completion cqe, uring::UserData user_data)
+{
+	using namespace ringnet::uring;
+
+	switch (user_data.op()) {
+	case Operation::WAKEUP:
+		// Woken up by another loop: posted tasks are run at the end of the iteration.
+		return true;
+	case Operation::MESSAGE:
+		// The target ring could not be messaged: fall back to its event file descriptor.
+		if (cqe->res < 0)
+			static_cast<EventLoop *>(user_data.header()->user_data)->signal();
+		return true;
+	case Operation::TIMEOUT:
+		// Expired timers are run at the end of the iteration (-ETIME is the expected result).
+		if (user_data.request<TimeoutRequest>() == armed_timeout)
+			armed_timeout = nullptr;
+		return true;
+	case Operation::TIMEOUT_UPDATE:
+		// Fails if the timeout already expired: its own completion follows.
+		return true;
+	case Operation::LINK_TIMEOUT: {
+		// Released along with its request: completed, either on expiry (-ETIME) or with the request.
+		RequestHeader *header = user_data.header();
+		LinkedTimeout *timeout = linkedTimeoutOf(*header);
+		timeout->expired = (cqe->res == -ETIME);
+		if (timeout->cancellation_pending && header->user_data) {
+			const int error_code = timeout->expired ? ETIMEDOUT : ECANCELED;
+			notify(UserData::of(*header), events::ErrorEvent{ .error_code = error_code });
+		}
+		return true;
+	}
+	case Operation::CANCEL:
+	case Operation::CLOSE:
+		// No subscriber to notify: the cancelled requests report their own completion.
+		return true;
+	default:
+		return false;
+	}
+}
+
+void EventLoop::schedule(time::Timer &timer, std::chrono::nanoseconds delay)
+{
+	timers.schedule(timer, Clock::now() + delay);
+}
+
+void EventLoop::cancel(time::Timer &timer)
+{
+	timers.cancel(timer);
+}
+
+void EventLoop::runTimers()
+{
+	using ringnet::time::chrono_utils::to_timespec;
+
+	timers.advance(Clock::now());
+
+	std::optional<Clock::time_point> deadline = timers.nextDeadline();
+	if (!deadline.has_value())
+		return;
+
+	// Urgent: a deferred submission would delay the timers. Without room for the request, retried on next
+	// iteration.
+	if (!armed_timeout) {
+		uring::TimeoutRequest request{ .deadline = to_timespec(deadline->time_since_epoch()) };
+		request.header.flags = uring::URGENT;
+		armed_timeout = submission_queue.push(std::move(request));
+		armed_deadline = deadline.value();
+	} else if (deadline.value() < armed_deadline) {
+		uring::TimeoutUpdateRequest request{ .timeout = armed_timeout,
+						     .deadline = to_timespec(deadline->time_since_epoch()) };
+		request.header.flags = uring::URGENT;
+		if (submission_queue.push(std::move(request)))
+			armed_deadline = deadline.value();
+	}
+}
+
+uring::SubmitStatus EventLoop::submitThenIdle()
+{
+	using Mode = IdleStrategy::Mode;
+
+	if (submission_queue.hasCompletions())
+		return submission_queue.submit();
+
+	switch (idle_strategy.mode) {
+	case Mode::BLOCK: {
+		const Clock::time_point idle_start = Clock::now();
+		uring::SubmitStatus status = submission_queue.submit(idle_strategy.block_timeout);
+		statistics_.idle_time += Clock::now() - idle_start;
+		return status;
+	}
+	case Mode::SPIN_THEN_BLOCK: {
+		uring::SubmitStatus status = submission_queue.submit();
+		if (status < 0 && !submission_queue.shouldContinueSubmitting(status))
+			return status;
+		if (spin(idle_strategy.spin_duration))
+			return status;
+
+		const Clock::time_point idle_start = Clock::now();
+		uring::SubmitStatus wait_status = submission_queue.wait(idle_strategy.block_timeout);
+		statistics_.idle_time += Clock::now() - idle_start;
+		return (wait_status < 0) ? wait_status : status;
+	}
+	case Mode::BUSY_POLL: {
+		uring::SubmitStatus status = submission_queue.submit();
+		spin(idle_strategy.spin_duration);
+		return status;
+	}
+	}
+	return submission_queue.submit();
+}
+
+bool EventLoop::spin(std::chrono::nanoseconds duration)
+{
+	const Clock::time_point idle_start = Clock::now();
+	const Clock::time_point deadline = idle_start + duration;
+
+	bool has_completions = submission_queue.pollCompletions();
+	Clock::time_point now = Clock::now();
+	while (!has_completions && now < deadline && should_continue) {
+		has_completions = submission_queue.pollCompletions();
+		now = Clock::now();
+	}
+
+	statistics_.idle_time += now - idle_start;
+	return has_completions;
+}
+
+void EventLoop::setIdleStrategy(const IdleStrategy &strategy)
+{
+	idle_strategy = strategy;
+}
+
+void EventLoop::setBatchingPolicy(const BatchingPolicy &policy)
+{
+	submission_queue.setBatchingPolicy(policy);
+}
+
+void EventLoop::setCompletionBudget(size_t budget)
+{
+	assert(budget > 0);
+	completion_budget = budget;
+}
+
+const EventLoop::Statistics &EventLoop::statistics() const
 {
-	return static_cast<Subscriber *>(header->user_data);
+	return statistics_;
 }
 
 EventLoop::~EventLoop()
 {
 	stop();
+	if (wakeup_fd >= 0)
+		::close(wakeup_fd);
 }
 
 void EventLoop::stop()
 {
 	should_continue = false;
+	signal();
 }
 
 } // namespace ringnet
\ No newline at end of file
@@ -1,3 +1,9 @@
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <memory>
+#include <optional>
+
 #include "ringnet/net/connection.hpp"
 
 namespace ringnet::net
@@ -8,17 +14,66 @@ Connection::Connection(ringnet::EventLoop &loop_, FileDescriptor &&socket_)
 {
 }
 
+Connection::Connection(ringnet::EventLoop &loop_, net::FixedFile &&socket_)
+	: loop(std::ref(loop_)), socket(), fixed_file(std::move(socket_)), endpoint_{ .fd = fixed_file.index },
+	  request_flags(uring::FIXED_FILE)
+{
+}
+
 Connection::~Connection()
 {
 	if (socket)
-		loop.get().cancel(socket.fd);
+		loop.get().closeFile(socket.release());
+	else if (fixed_file)
+		loop.get().closeFixedFile(fixed_file.index);
+}
+
+Connection &Connection::operator=(Connection &&other)
+{
+	if (this != &other) {
+		std::destroy_at(this);
+		std::construct_at(this, std::move(other));
+	}
+	return *this;
 }
 
 MessagedStatus Connection::asyncRead()
 {
 	ringnet::uring::MultiShotReadRequest request;
-	request.fd = socket.fd;
-	uring::AddRequestStatus status = loop.get().add(request, subscriber.get());
+	request.fd = endpoint_.fd;
+	request.buffer_group_id = bufferGroupId();
+	request.header.flags = request_flags;
+	uring::AddRequestStatus status = loop.get().add(request, subscriber());
+	if (status == ringnet::uring::QUEUE_FULL)
+		return MessagedStatus{ false, "Request queue is full" };
+
+	return MessagedStatus{ true, "Success" };
+}
+
+MessagedStatus Connection::asyncReadBundles()
+{
+	if (!loop.get().supportsReceiveBundles())
+		return MessagedStatus{ false, "Receive bundles are not supported by the kernel" };
+
+	ringnet::uring::BundleReadRequest request;
+	request.fd = endpoint_.fd;
+	request.buffer_group_id = bufferGroupId();
+	request.header.flags = request_flags;
+	uring::AddRequestStatus status = loop.get().add(request, subscriber());
+	if (status == ringnet::uring::QUEUE_FULL)
+		return MessagedStatus{ false, "Request queue is full" };
+
+	return MessagedStatus{ true, "Success" };
+}
+
+MessagedStatus Connection::asyncRead(std::chrono::nanoseconds timeout)
+{
+	ringnet::uring::ProvidedBufferReadRequest request;
+	request.fd = endpoint_.fd;
+	request.buffer_group_id = bufferGroupId();
+	request.header.flags = request_flags;
+	request.timeout = uring::LinkedTimeout::after(timeout);
+	uring::AddRequestStatus status = loop.get().add(request, subscriber());
 	if (status == ringnet::uring::QUEUE_FULL)
 		return MessagedStatus{ false, "Request queue is full" };
 
@@ -27,16 +82,391 @@ MessagedStatus Connection::asyncRead()
 
 MessagedStatus Connection::asyncWrite(std::span<const std::byte> sent_bytes)
 {
+	return asyncWrite(sent_bytes, uring::LinkedTimeout{});
+}
+
+MessagedStatus Connection::asyncWrite(std::span<const std::byte> sent_bytes, std::chrono::nanoseconds timeout)
+{
+	return asyncWrite(sent_bytes, uring::LinkedTimeout::after(timeout));
+}
+
+MessagedStatus Connection::asyncWrite(std::span<const std::byte> sent_bytes, const uring::LinkedTimeout &timeout)
+{
+	if (corked && !timeout.enabled) {
+		corked_writes->add(sent_bytes, request_flags);
+		return MessagedStatus{ true, "Success" };
+	}
+
 	ringnet::uring::WriteRequest request;
-	request.fd = socket.fd;
+	request.fd = endpoint_.fd;
+	request.header.flags = request_flags;
 	request.bytes_written = sent_bytes;
-	uring::AddRequestStatus status = loop.get().add(request, subscriber.get());
+	request.timeout = timeout;
+	uring::AddRequestStatus status = loop.get().add(request, subscriber());
 	if (status == ringnet::uring::QUEUE_FULL)
 		return MessagedStatus{ false, "Request queue is full" };
 
 	return MessagedStatus{ true, "Success" };
 }
 
+MessagedStatus Connection::asyncWrite(uring::SendBuffer &&buffer, size_t length)
+{
+	if (!buffer)
+		return MessagedStatus{ false, "No send buffer" };
+	if (length > buffer.bytes().size())
+		return MessagedStatus{ false, "Length beyond the send buffer" };
+
+	ringnet::uring::WriteFixedRequest request;
+	request.fd = endpoint_.fd;
+	request.header.flags = request_flags;
+	request.buffer_index = buffer.index();
+	request.bytes_written = buffer.bytes().subspan(0, length);
+	uring::AddRequestStatus status = loop.get().add(request, subscriber());
+	if (status == ringnet::uring::QUEUE_FULL)
+		return MessagedStatus{ false, "Request queue is full" };
+
+	// From now on, given back by the request.
+	buffer.detach();
+	return MessagedStatus{ true, "Success" };
+}
+
+void Connection::setCorked(bool corked_, bool more_to_come)
+{
+	corked = corked_;
+	if (!corked)
+		return;
+	if (!corked_writes)
+		corked_writes = std::make_unique<CorkedWrites>(loop.get(), subscriber(), endpoint_.fd);
+	corked_writes->more_to_come = more_to_come;
+}
+
+void Connection::CorkedWrites::add(std::span<const std::byte> sent_bytes, uint8_t flags)
+{
+	request_flags = flags;
+	pending.push_back(sent_bytes);
+	loop.get().scheduleFlush(*this);
+}
+
+void Connection::CorkedWrites::flushPending(FlushSink &sink)
+{
+	CorkedWrites &self = static_cast<CorkedWrites &>(sink);
+	// Flushed again once the write in flight completes.
+	if (self.writing || self.pending.empty())
+		return;
+
+	// Beyond IOV_MAX buffers, the write would fail (EMSGSIZE): the rest is flushed once it completes.
+	const size_t gathered = std::min(self.pending.size(), static_cast<size_t>(IOV_MAX));
+	self.in_flight.clear();
+	for (size_t index = 0; index < gathered; index++) {
+		std::span<const std::byte> bytes = self.pending[index];
+		if (index == 0)
+			bytes = bytes.subspan(self.written);
+		self.in_flight.push_back(
+			iovec{ .iov_base = const_cast<std::byte *>(bytes.data()), .iov_len = bytes.size() });
+	}
+
+	ringnet::uring::WritevRequest request;
+	request.fd = self.fd;
+	request.header.flags = self.request_flags;
+	request.buffers = self.in_flight;
+	request.message_flags = self.more_to_come ? MSG_MORE : 0;
+	self.writing = self.loop.get().push(request, static_cast<CompletionSink *>(&self));
+	if (!self.writing) {
+		// Retried on next iteration.
+		self.loop.get().scheduleFlush(self);
+		return;
+	}
+}
+
+void Connection::CorkedWrites::fail(events::ErrorEvent &&error)
+{
+	// The connection is broken: the gathered writes cannot be delivered either.
+	loop.get().cancelFlush(*this);
+	pending.clear();
+	written = 0;
+	subscriber->handle(std::move(error));
+}
+
+void Connection::CorkedWrites::deliver(CompletionSink &sink, Event &&event)
+{
+	CorkedWrites &self = static_cast<CorkedWrites &>(sink);
+	self.writing = nullptr;
+
+	if (events::ErrorEvent *error = std::get_if<events::ErrorEvent>(&event)) {
+		self.fail(std::move(*error));
+		return;
+	}
+	size_t written_now = std::get<events::WriteEvent>(event).vectored_size;
+	// Nothing written out of a non-empty write: resubmitting would spin.
+	if (written_now == 0 && self.in_flight.front().iov_len > 0) {
+		self.fail(events::ErrorEvent{ .error_code = EIO });
+		return;
+	}
+
+	// Notified per write, once completely written, as if submitted separately. A short write stops within one of
+	// them: its rest is written first by the next vectored write, keeping the bytes in order.
+	size_t completed_count = 0;
+	for (const iovec &buffer : self.in_flight) {
+		if (written_now < buffer.iov_len)
+			break;
+		written_now -= buffer.iov_len;
+		++completed_count;
+	}
+	self.written = (completed_count == 0 ? self.written : 0) + written_now;
+	if (self.pending.size() > completed_count)
+		self.loop.get().scheduleFlush(self);
+
+	// Popped one at a time: the callbacks may issue more writes, gathered behind.
+	for (size_t index = 0; index < completed_count; index++) {
+		const std::span<const std::byte> bytes = self.pending.front();
+		self.pending.pop_front();
+		self.subscriber->handle(events::WriteEvent{ .fd = self.fd, .bytes_written = bytes });
+	}
+}
+
+MessagedStatus Connection::asyncWritev(std::span<const iovec> buffers)
+{
+	ringnet::uring::WritevRequest request;
+	request.fd = endpoint_.fd;
+	request.header.flags = request_flags;
+	request.buffers = buffers;
+	uring::AddRequestStatus status = loop.get().add(request, subscriber());
+	if (status == ringnet::uring::QUEUE_FULL)
+		return MessagedStatus{ false, "Request queue is full" };
+
+	return MessagedStatus{ true, "Success" };
+}
+
+MessagedStatus Connection::asyncSendZeroCopy(std::span<const std::byte> sent_bytes)
+{
+	ringnet::uring::SendZeroCopyRequest request;
+	request.fd = endpoint_.fd;
+	request.header.flags = request_flags;
+	request.bytes_sent = sent_bytes;
+	uring::AddRequestStatus status = loop.get().add(request, subscriber());
+	if (status == ringnet::uring::QUEUE_FULL)
+		return MessagedStatus{ false, "Request queue is full" };
+
+	return MessagedStatus{ true, "Success" };
+}
+
+MessagedStatus Connection::enqueueWrite(std::span<const std::byte> sent_bytes)
+{
+	WriteQueue &queue = writeQueue();
+	queue.request_flags = request_flags;
+	queue.spans.push_back(sent_bytes);
+	queue.queued_bytes += sent_bytes.size();
+
+	// With a retry scheduled, the bytes wait for it.
+	if (!queue.writeNext() && !queue.scheduled) {
+		queue.spans.pop_back();
+		queue.queued_bytes -= sent_bytes.size();
+		return MessagedStatus{ false, "Request queue is full" };
+	}
+
+	if (!queue.above_high_watermark && queue.queued_bytes >= queue.high_watermark) {
+		queue.above_high_watermark = true;
+		if (queue.on_high_watermark)
+			queue.on_high_watermark();
+	}
+	return MessagedStatus{ true, "Success" };
+}
+
+size_t Connection::queuedBytes() const
+{
+	return write_queue ? write_queue->queued_bytes : 0;
+}
+
+void Connection::setWriteWatermarks(size_t low_watermark, size_t high_watermark)
+{
+	assert(low_watermark < high_watermark);
+	writeQueue().low_watermark = low_watermark;
+	writeQueue().high_watermark = high_watermark;
+}
+
+Connection::WriteQueue &Connection::writeQueue()
+{
+	if (!write_queue)
+		write_queue = std::make_unique<WriteQueue>(loop.get(), subscriber(), endpoint_.fd);
+	return *write_queue;
+}
+
+Connection::WriteQueue::~WriteQueue()
+{
+	loop.get().cancelFlush(*this);
+	if (in_flight)
+		EventLoop::detach(*in_flight);
+}
+
+bool Connection::WriteQueue::writeNext()
+{
+	if (in_flight || spans.empty())
+		return true;
+
+	ringnet::uring::WriteRequest request;
+	request.fd = fd;
+	request.header.flags = request_flags;
+	request.bytes_written = spans.front().subspan(written);
+	in_flight = loop.get().push(request, static_cast<CompletionSink *>(this));
+	return in_flight != nullptr;
+}
+
+void Connection::WriteQueue::fail(events::ErrorEvent &&error)
+{
+	// The connection is broken: nothing queued can be delivered anymore.
+	loop.get().cancelFlush(*this);
+	spans.clear();
+	written = 0;
+	queued_bytes = 0;
+	above_high_watermark = false;
+	subscriber->handle(std::move(error));
+}
+
+void Connection::WriteQueue::retryNext(FlushSink &sink)
+{
+	WriteQueue &self = static_cast<WriteQueue &>(sink);
+	if (!self.writeNext())
+		self.loop.get().scheduleFlush(self);
+}
+
+void Connection::WriteQueue::deliver(CompletionSink &sink, Event &&event)
+{
+	WriteQueue &self = static_cast<WriteQueue &>(sink);
+	self.in_flight = nullptr;
+
+	if (events::ErrorEvent *error = std::get_if<events::ErrorEvent>(&event)) {
+		self.fail(std::move(*error));
+		return;
+	}
+
+	const size_t written_now = std::get<events::WriteEvent>(event).bytes_written.size();
+	// Nothing written out of a non-empty span: resubmitting would spin.
+	if (written_now == 0 && !self.spans.front().empty()) {
+		self.fail(events::ErrorEvent{ .error_code = EIO });
+		return;
+	}
+	self.written += written_now;
+	self.queued_bytes -= written_now;
+
+	std::optional<std::span<const std::byte>> completed{};
+	if (self.written == self.spans.front().size()) {
+		completed = self.spans.front();
+		self.spans.pop_front();
+		self.written = 0;
+	}
+
+	// Resumed before notifying: the callbacks may enqueue more bytes.
+	// Without room for the request, the bytes stay queued: retried on the next flush.
+	if (!self.writeNext())
+		self.loop.get().scheduleFlush(self);
+
+	const bool below_low_watermark = self.above_high_watermark && self.queued_bytes <= self.low_watermark;
+	if (below_low_watermark)
+		self.above_high_watermark = false;
+
+	if (completed.has_value())
+		self.subscriber->handle(events::WriteEvent{ .fd = self.fd, .bytes_written = completed.value() });
+	if (below_low_watermark && self.on_low_watermark)
+		self.on_low_watermark();
+}
+
+Connection::ReadOperation Connection::read()
+{
+	ringnet::uring::ProvidedBufferReadRequest request;
+	request.fd = endpoint_.fd;
+	request.buffer_group_id = bufferGroupId();
+	request.header.flags = request_flags;
+	return ReadOperation{ loop.get(), request };
+}
+
+Connection::ReadIntoOperation Connection::read(std::span<std::byte> reception_buffer)
+{
+	ringnet::uring::ReadRequest request;
+	request.fd = endpoint_.fd;
+	request.header.flags = request_flags;
+	request.reception_buffer = reception_buffer;
+	return ReadIntoOperation{ loop.get(), request };
+}
+
+Connection::WriteOperation Connection::write(std::span<const std::byte> sent_bytes)
+{
+	ringnet::uring::WriteRequest request;
+	request.fd = endpoint_.fd;
+	request.header.flags = request_flags;
+	request.bytes_written = sent_bytes;
+	return WriteOperation{ loop.get(), request };
+}
+
+ringnet::Subscriber *Connection::subscriber()
+{
+	if (!subscriber_)
+		subscriber_ = std::make_unique<ringnet::Subscriber>();
+	return subscriber_.get();
+}
+
+void Connection::setBufferClass(size_t size_class)
+{
+	bufferSizing().setClass(size_class);
+}
+
+size_t Connection::bufferClass() const
+{
+	return buffer_sizing ? buffer_sizing->size_class : 0;
+}
+
+void Connection::setBufferPromotion(bool enabled)
+{
+	BufferSizing &sizing = bufferSizing();
+	sizing.promotion = enabled;
+	sizing.full_reads = 0;
+}
+
+Connection::BufferSizing &Connection::bufferSizing()
+{
+	if (!buffer_sizing)
+		buffer_sizing = std::make_unique<BufferSizing>(loop, endpoint_.fd, request_flags);
+	return *buffer_sizing;
+}
+
+uint16_t Connection::bufferGroupId() const
+{
+	return loop.get().bufferGroupId(bufferClass());
+}
+
+void Connection::BufferSizing::setClass(size_t size_class_)
+{
+	size_class_ = std::min(size_class_, loop.get().bufferClassesCount() - 1);
+	if (size_class_ == size_class)
+		return;
+	size_class = size_class_;
+	full_reads = 0;
+	loop.get().switchBufferClass(fd, request_flags, size_class);
+}
+
+void Connection::BufferSizing::observe(const events::ReadEvent &event)
+{
+	if (!promotion)
+		return;
+
+	size_t bytes_read = event.bytes_read.size();
+	for (size_t index = 1; index < event.buffers.size(); index++)
+		bytes_read += event.buffers[index].size();
+	if (bytes_read < loop.get().bufferSize(size_class)) {
+		full_reads = 0;
+		return;
+	}
+	if (++full_reads >= PROMOTION_READS)
+		setClass(size_class + 1);
+}
+
+void Connection::setLatencyCritical(bool latency_critical)
+{
+	if (latency_critical)
+		request_flags |= uring::URGENT;
+	else
+		request_flags &= ~uring::URGENT;
+}
+
 const Endpoint &Connection::endpoint() const
 {
 	return endpoint_;
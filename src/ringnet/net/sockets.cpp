@@ -1,3 +1,5 @@
+#include <utility>
+
 #include "ringnet/net/sockets.hpp"
 
 namespace ringnet::net
@@ -26,6 +28,27 @@ FileDescriptor::~FileDescriptor()
 	fd = INVALID;
 }
 
+FileDescriptor::Raw FileDescriptor::release()
+{
+	return std::exchange(fd, INVALID);
+}
+
+FixedFile::FixedFile(Index index_) : index(index_)
+{
+}
+
+FixedFile::FixedFile(FixedFile &&other) : index(other.index)
+{
+	other.index = INVALID;
+}
+
+FixedFile &FixedFile::operator=(FixedFile &&other)
+{
+	using std::swap;
+	swap(index, other.index);
+	return *this;
+}
+
 std::pair<const sockaddr *, size_t> SocketAddress::as_sockaddr() const
 {
 	if (auto ptr_v4 = std::get_if<sockaddr_in>(&underlying); ptr_v4)
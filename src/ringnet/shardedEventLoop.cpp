@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <pthread.h>
+#include <sched.h>
+
+#include "ringnet/shardedEventLoop.hpp"
+
+namespace ringnet
+{
+
+ShardedEventLoop::ShardedEventLoop(size_t shards_count_, size_t request_queue_size_, bool pin_threads_,
+				   const uring::RingConfig &ring_config_)
+	: shards_count(std::max<size_t>(shards_count_, 1)), request_queue_size(request_queue_size_),
+	  pin_threads(pin_threads_), ring_config(ring_config_)
+{
+}
+
+ShardedEventLoop::~ShardedEventLoop()
+{
+	stop();
+}
+
+void ShardedEventLoop::stop()
+{
+	std::lock_guard<std::mutex> lock{ loops_mutex };
+	stopped = true;
+	for (EventLoop *loop : loops)
+		loop->stop();
+}
+
+void ShardedEventLoop::restart()
+{
+	std::lock_guard<std::mutex> lock{ loops_mutex };
+	stopped = false;
+}
+
+size_t ShardedEventLoop::size() const
+{
+	return shards_count;
+}
+
+void ShardedEventLoop::runLoop(EventLoop &loop)
+{
+	{
+		std::lock_guard<std::mutex> lock{ loops_mutex };
+		if (stopped)
+			return;
+		loops.push_back(&loop);
+	}
+
+	auto detach = [this, &loop]() {
+		std::lock_guard<std::mutex> lock{ loops_mutex };
+		loops.erase(std::remove(loops.begin(), loops.end(), &loop), loops.end());
+	};
+
+	try {
+		loop.run();
+	} catch (...) {
+		detach();
+		throw;
+	}
+	detach();
+}
+
+void ShardedEventLoop::fail(std::exception_ptr error)
+{
+	{
+		std::lock_guard<std::mutex> lock{ loops_mutex };
+		if (!first_error)
+			first_error = error;
+	}
+	stop();
+}
+
+void ShardedEventLoop::pin(size_t shard_index)
+{
+	// Only consider the cores this process is allowed to run on (e.g. restricted by taskset or a cgroup).
+	cpu_set_t allowed_cpus;
+	CPU_ZERO(&allowed_cpus);
+	if (sched_getaffinity(0, sizeof(allowed_cpus), &allowed_cpus) != 0)
+		return;
+
+	const int allowed_count = CPU_COUNT(&allowed_cpus);
+	if (allowed_count <= 0)
+		return;
+
+	int remaining = static_cast<int>(shard_index % static_cast<size_t>(allowed_count));
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (!CPU_ISSET(cpu, &allowed_cpus))
+			continue;
+		if (remaining-- > 0)
+			continue;
+
+		cpu_set_t shard_cpu;
+		CPU_ZERO(&shard_cpu);
+		CPU_SET(cpu, &shard_cpu);
+		pthread_setaffinity_np(pthread_self(), sizeof(shard_cpu), &shard_cpu);
+		return;
+	}
+}
+
+} // namespace ringnet
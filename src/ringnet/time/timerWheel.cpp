@@ -0,0 +1,194 @@
+#include <algorithm>
+
+#include "ringnet/time/timerWheel.hpp"
+
+namespace ringnet::time
+{
+
+Timer::~Timer()
+{
+	if (wheel)
+		wheel->cancel(*this);
+}
+
+TimerWheel::TimerWheel(Clock::duration resolution_, Clock::time_point origin_)
+	: resolution(resolution_), origin(origin_)
+{
+}
+
+TimerWheel::~TimerWheel()
+{
+	// Detach the remaining timers, which may outlive the wheel.
+	for (Level &level : levels) {
+		for (TimerLink &slot : level) {
+			while (!slot.empty()) {
+				Timer &timer = static_cast<Timer &>(*slot.next);
+				timer.unlink();
+				timer.wheel = nullptr;
+			}
+		}
+	}
+}
+
+void TimerWheel::schedule(Timer &timer, Clock::time_point deadline)
+{
+	cancel(timer);
+
+	// Round up: a timer never expires before its deadline.
+	const Clock::duration since_origin = (deadline > origin) ? (deadline - origin) : Clock::duration{};
+	uint64_t expiry_tick = since_origin / resolution;
+	if (since_origin % resolution != Clock::duration{})
+		++expiry_tick;
+
+	timer.expiry_tick = std::max(expiry_tick, current_tick + 1);
+	timer.wheel = this;
+	insert(timer);
+	++timers_count;
+}
+
+void TimerWheel::cancel(Timer &timer)
+{
+	if (timer.wheel != this)
+		return;
+
+	timer.unlink();
+	timer.wheel = nullptr;
+	--level_counts[timer.level];
+	--timers_count;
+}
+
+size_t TimerWheel::advance(Clock::time_point now)
+{
+	const uint64_t target_tick = tickOf(now);
+	size_t expired_count = 0;
+
+	while (current_tick < target_tick) {
+		if (empty()) {
+			current_tick = target_tick;
+			break;
+		}
+		// Skip to the last tick before the next cascade of the lowest non-empty level: nothing expires before.
+		size_t empty_levels = 0;
+		while (empty_levels + 1 < LEVELS && level_counts[empty_levels] == 0)
+			++empty_levels;
+		if (empty_levels > 0) {
+			const uint64_t range = uint64_t{ 1 } << (SLOT_BITS * empty_levels);
+			const uint64_t skipped_tick = (current_tick | (range - 1));
+			if (skipped_tick > current_tick) {
+				current_tick = std::min(skipped_tick, target_tick);
+				continue;
+			}
+		}
+
+		++current_tick;
+		cascade();
+		expired_count += expire();
+	}
+	return expired_count;
+}
+
+std::optional<TimerWheel::Clock::time_point> TimerWheel::nextDeadline() const
+{
+	if (empty())
+		return std::nullopt;
+
+	std::optional<uint64_t> earliest{};
+	for (size_t level = 0; level < LEVELS; level++) {
+		const std::optional<uint64_t> expiry = earliestExpiry(level);
+		if (expiry.has_value() && (!earliest.has_value() || *expiry < *earliest))
+			earliest = expiry;
+	}
+	return origin + resolution * std::max(*earliest, current_tick + 1);
+}
+
+std::optional<uint64_t> TimerWheel::earliestExpiry(size_t level) const
+{
+	if (level_counts[level] == 0)
+		return std::nullopt;
+
+	// Slots are visited in the order of their ticks, from the one following the current slot of the level.
+	const uint64_t current_slot = current_tick >> (SLOT_BITS * level);
+	for (uint64_t offset = 1; offset <= SLOTS_PER_LEVEL; offset++) {
+		const size_t slot = (current_slot + offset) % SLOTS_PER_LEVEL;
+		if (!levels[level][slot].empty())
+			return slot_expiries[level][slot];
+	}
+	return std::nullopt;
+}
+
+void TimerWheel::insert(Timer &timer)
+{
+	// Timers beyond the range of the wheel wait in the farthest slot, and are re-inserted when cascaded.
+	static constexpr uint64_t MAX_DELTA = (uint64_t{ 1 } << (SLOT_BITS * LEVELS)) - 1;
+	const uint64_t delta = std::min(timer.expiry_tick - current_tick, MAX_DELTA);
+	const uint64_t slotted_tick = current_tick + delta;
+
+	size_t level = 0;
+	while (level + 1 < LEVELS && delta >= (uint64_t{ 1 } << (SLOT_BITS * (level + 1))))
+		++level;
+
+	const size_t slot = (slotted_tick >> (SLOT_BITS * level)) % SLOTS_PER_LEVEL;
+	uint64_t &slot_expiry = slot_expiries[level][slot];
+	slot_expiry = levels[level][slot].empty() ? timer.expiry_tick : std::min(slot_expiry, timer.expiry_tick);
+	levels[level][slot].pushBack(timer);
+	timer.level = level;
+	++level_counts[level];
+}
+
+void TimerWheel::cascade()
+{
+	size_t highest_level = 0;
+	while (highest_level + 1 < LEVELS &&
+	       (current_tick & ((uint64_t{ 1 } << (SLOT_BITS * (highest_level + 1))) - 1)) == 0)
+		++highest_level;
+
+	// From the top: timers cascaded from a level may land in the current slot of the level below.
+	for (size_t level = highest_level; level > 0; --level) {
+		TimerLink &slot = levels[level][(current_tick >> (SLOT_BITS * level)) % SLOTS_PER_LEVEL];
+		TimerLink cascaded{};
+		while (!slot.empty()) {
+			TimerLink &link = *slot.next;
+			link.unlink();
+			cascaded.pushBack(link);
+			--level_counts[level];
+		}
+		while (!cascaded.empty()) {
+			Timer &timer = static_cast<Timer &>(*cascaded.next);
+			timer.unlink();
+			insert(timer);
+		}
+	}
+}
+
+size_t TimerWheel::expire()
+{
+	TimerLink &slot = levels[0][current_tick % SLOTS_PER_LEVEL];
+
+	// Callbacks may schedule or cancel any timer: detach the expired ones first.
+	TimerLink expired{};
+	while (!slot.empty()) {
+		TimerLink &link = *slot.next;
+		link.unlink();
+		expired.pushBack(link);
+	}
+
+	size_t expired_count = 0;
+	while (!expired.empty()) {
+		Timer &timer = static_cast<Timer &>(*expired.next);
+		timer.unlink();
+		timer.wheel = nullptr;
+		--level_counts[0];
+		--timers_count;
+		++expired_count;
+		if (timer.callback)
+			timer.callback();
+	}
+	return expired_count;
+}
+
+uint64_t TimerWheel::tickOf(Clock::time_point time) const
+{
+	return (time > origin) ? static_cast<uint64_t>((time - origin) / resolution) : 0;
+}
+
+} // namespace ringnet::time
@@ -1,53 +1,315 @@
+#include <algorithm>
+#include <bit>
+#include <utility>
+
+#include <unistd.h>
+
 #include "ringnet/uring/submissionQueue.hpp"
 
 namespace ringnet::uring
 {
 
-SubmissionQueue::SubmissionQueue(size_t queue_size)
+SubmissionQueue::SubmissionQueue(size_t queue_size, const RingConfig &config)
+	: request_pool(requestPoolCapacity(queue_size, config))
 {
-	throwOnError(io_uring_queue_init(queue_size, &ring, 0), "Error initializing io_uring");
+	io_uring_params params{};
+
+	if (config.defer_taskrun && config.submission_polling.enabled)
+		throw std::invalid_argument("Deferred task work is incompatible with submission polling");
+
+	if (config.submission_polling.enabled) {
+		params.flags |= IORING_SETUP_SQPOLL;
+		params.sq_thread_idle = static_cast<uint32_t>(config.submission_polling.idle_timeout.count());
+		if (config.submission_polling.cpu.has_value()) {
+			params.flags |= IORING_SETUP_SQ_AFF;
+			params.sq_thread_cpu = config.submission_polling.cpu.value();
+		}
+	}
+
+	if (config.single_issuer || config.defer_taskrun)
+		params.flags |= IORING_SETUP_SINGLE_ISSUER;
+	// The kernel flags pending task work in the submission queue flags (IORING_SQ_TASKRUN): see flushTaskWork.
+	if (config.defer_taskrun)
+		params.flags |= IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_TASKRUN_FLAG;
+	if (config.coop_taskrun)
+		params.flags |= IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG;
+
+	if (config.completion_queue_size.has_value()) {
+		params.flags |= IORING_SETUP_CQSIZE;
+		params.cq_entries = config.completion_queue_size.value();
+	}
+
+	throwOnError(io_uring_queue_init_params(queue_size, &ring, &params), "Error initializing io_uring");
+
+	// Older kernels drop completions once the completion queue is full, which would silently lose requests.
+	if (!(params.features & IORING_FEAT_NODROP)) {
+		io_uring_queue_exit(&ring);
+		throw std::runtime_error("Error initializing io_uring: completion queue overflows are not supported");
+	}
+	features = params.features;
+
+	if (config.register_ring_fd) {
+		int registered = io_uring_register_ring_fd(&ring);
+		if (registered < 0) {
+			io_uring_queue_exit(&ring);
+			throwOnError(registered, "Error registering io_uring file descriptor");
+		}
+	}
+
+	if (config.fixed_files > 0) {
+		int registered = io_uring_register_files_sparse(&ring, config.fixed_files);
+		if (registered < 0) {
+			io_uring_queue_exit(&ring);
+			throwOnError(registered, "Error registering the fixed-file table");
+		}
+		fixed_files_count = config.fixed_files;
+	}
+
+	int registered = send_buffers.setup(ring, config.send_buffers);
+	if (registered < 0) {
+		io_uring_queue_exit(&ring);
+		throwOnError(registered, "Error registering the send buffers");
+	}
 }
 
 SubmissionQueue::~SubmissionQueue()
 {
+	// Files handed over to be closed once cancelled (see closeFile): the ring cancels every request on exit, so
+	// close them now. Those already prepared go with the submission.
+	if (io_uring_sq_ready(&ring) > 0)
+		io_uring_submit(&ring);
+	SlotLink *link = std::exchange(unprepared_request, nullptr);
+	for (link = link ? link : pending_requests.pop(); link; link = pending_requests.pop()) {
+		RequestHeader *header = headerOf(link);
+		if (header->op == Operation::CLOSE && !header->has(FIXED_FILE))
+			::close(reinterpret_cast<CloseRequest *>(header)->fd);
+	}
 	io_uring_queue_exit(&ring);
 }
 
-void SubmissionQueue::cancel(int fd)
+bool SubmissionQueue::cancel(int fd)
 {
-	io_uring_sqe *sqe = getNewSubmissionQueueEntry();
+	return push(CancelRequest{ .fd = fd }) != nullptr;
+}
 
-	if (!sqe)
-		return;
+bool SubmissionQueue::closeFile(int fd)
+{
+	return cancelThenClose(fd, 0);
+}
+
+bool SubmissionQueue::closeFixedFile(int index)
+{
+	assert(index >= 0 && static_cast<uint32_t>(index) < fixed_files_count);
+	return cancelThenClose(index, FIXED_FILE);
+}
+
+bool SubmissionQueue::cancelThenClose(int fd, uint8_t flags)
+{
+	CancelRequest cancel_request{ .fd = fd, .detach = true };
+	cancel_request.header.flags = flags;
+	if (!push(cancel_request))
+		return false;
+	detachRequests(fd, cancel_request.header);
+
+	// Queued after the cancellation: the file is only closed once its requests are cancelled. Closed right
+	// away, the file descriptor would no longer match them, or match another file reusing its number.
+	CloseRequest close_request{ .fd = fd };
+	close_request.header.flags = flags;
+	return push(std::move(close_request)) != nullptr;
+}
 
-	io_uring_prep_cancel_fd(sqe, fd, IORING_ASYNC_CANCEL_ALL | IORING_ASYNC_CANCEL_FD);
+size_t SubmissionQueue::switchBufferGroup(int fd, uint8_t flags, uint16_t buffer_group_id)
+{
+	RequestHeader file_header{};
+	file_header.flags = flags;
+	size_t switched = 0;
+	auto [first, last] = active_multishots.equal_range(fileKey(fd, file_header));
+	for (auto it = first; it != last; ++it) {
+		RequestHeader *header = it->second;
+		// Detached reads are about to be cancelled anyway.
+		if (!header->user_data)
+			continue;
+		if (header->op == Operation::READ_MULTISHOT) {
+			auto *request = reinterpret_cast<MultiShotReadRequest *>(header);
+			switched += switchBufferGroup(request, buffer_group_id);
+		} else if (header->op == Operation::READ_BUNDLE) {
+			auto *request = reinterpret_cast<BundleReadRequest *>(header);
+			switched += switchBufferGroup(request, buffer_group_id);
+		}
+	}
+	return switched;
+}
+
+template <class Request>
+bool SubmissionQueue::switchBufferGroup(Request *request, uint16_t buffer_group_id)
+{
+	request->next_buffer_group_id = buffer_group_id;
+	if (request->buffer_group_id == buffer_group_id)
+		return false;
+
+	// Flagged once the cancellation is prepared: the read may terminate, and be armed again, in the meantime.
+	CancelRequest cancel_request{ .fd = request->fd, .rearmed = &request->header };
+	return push(std::move(cancel_request)) != nullptr;
+}
+
+bool SubmissionQueue::isArmed(int fd, const RequestHeader &header) const
+{
+	auto [first, last] = active_multishots.equal_range(fileKey(fd, header));
+	return std::any_of(first, last, [&header](const auto &entry) { return entry.second == &header; });
 }
 
-SubmitStatus SubmissionQueue::submit(std::chrono::milliseconds timeout)
+void SubmissionQueue::detachRequests(int fd, const RequestHeader &file_header)
+{
+	const uint64_t file_key = fileKey(fd, file_header);
+	auto [first, last] = active_multishots.equal_range(file_key);
+	for (auto it = first; it != last; ++it)
+		it->second->user_data = nullptr;
+	auto [first_subscribed, last_subscribed] = subscribed_requests.equal_range(file_key);
+	for (auto it = first_subscribed; it != last_subscribed; ++it)
+		it->second->user_data = nullptr;
+}
+
+void SubmissionQueue::trackSubscribed(int fd, RequestHeader &header)
+{
+	if (!header.has(NOTIFY_SINK))
+		subscribed_requests.emplace(fileKey(fd, header), &header);
+}
+
+bool SubmissionQueue::hasFeature(uint32_t feature) const
+{
+	return features & feature;
+}
+
+uint32_t SubmissionQueue::fixedFilesCount() const
+{
+	return fixed_files_count;
+}
+
+SendBuffer SubmissionQueue::leaseSendBuffer()
+{
+	return send_buffers.lease();
+}
+
+const SendBufferPool &SubmissionQueue::sendBuffers() const
+{
+	return send_buffers;
+}
+
+SubmitStatus SubmissionQueue::submit(std::chrono::nanoseconds timeout)
 {
 	static constexpr unsigned WAITED_COMPLETIONS = 1;
 	static constexpr sigset_t *BLOCKED_SIGNALS = nullptr;
 
-	size_t prepared_requests_count = preparePendingRequests();
+	preparePendingRequests();
+	const unsigned prepared_count = io_uring_sq_ready(&ring);
+	const bool should_wait = (timeout.count() > 0) && !hasCompletions();
 
-	if (prepared_requests_count == 0)
+	if (prepared_count == 0 || !shouldSubmit(prepared_count)) {
+		if (should_wait)
+			return wait(timeout);
+		flushTaskWork();
 		return SubmitStatus{ NOT_READY };
+	}
+
+	onSubmission();
+	// On a polled ring, only enters the kernel if the polling thread needs to be woken up (IORING_SQ_NEED_WAKEUP).
+	if (!should_wait || isPolled()) {
+		int submitted = io_uring_submit(&ring);
+		if (submitted < 0 || !should_wait)
+			return SubmitStatus{ submitted };
 
-	if (timeout.count() <= 0)
-		return SubmitStatus{ io_uring_submit_and_wait(&ring, WAITED_COMPLETIONS) };
+		SubmitStatus wait_status = wait(timeout);
+		return (wait_status < 0) ? wait_status : SubmitStatus{ submitted };
+	}
 
+	// Single syscall to both submit and wait.
 	__kernel_timespec timeout_ = ringnet::time::chrono_utils::to_timespec(timeout);
-	io_uring_cqe *completed_events = nullptr;
-	int completions = io_uring_submit_and_wait_timeout(&ring, &completed_events, WAITED_COMPLETIONS, &timeout_,
-							   BLOCKED_SIGNALS);
+	io_uring_cqe *completed_event = nullptr;
+	return SubmitStatus{ io_uring_submit_and_wait_timeout(&ring, &completed_event, WAITED_COMPLETIONS, &timeout_,
+							      BLOCKED_SIGNALS) };
+}
 
-	if (completions > 0 && completed_events == nullptr) {
-		int peek_status = io_uring_peek_cqe(&ring, &completed_events);
-		if (peek_status < 0)
-			return SubmitStatus{ peek_status };
-	}
+SubmitStatus SubmissionQueue::wait(std::chrono::nanoseconds timeout)
+{
+	if (std::optional<std::chrono::nanoseconds> delay_left = batchDelayLeft())
+		timeout = std::min(timeout, delay_left.value());
 
-	return SubmitStatus{ completions };
+	__kernel_timespec timeout_ = ringnet::time::chrono_utils::to_timespec(timeout);
+	io_uring_cqe *completed_event = nullptr;
+	return SubmitStatus{ io_uring_wait_cqe_timeout(&ring, &completed_event, &timeout_) };
+}
+
+void SubmissionQueue::setBatchingPolicy(const BatchingPolicy &policy)
+{
+	batching_policy = policy;
+}
+
+uint64_t SubmissionQueue::submissionsCount() const
+{
+	return submissions_count;
+}
+
+uint64_t SubmissionQueue::submittedEntriesCount() const
+{
+	return submitted_entries_count;
+}
+
+bool SubmissionQueue::shouldSubmit(unsigned prepared_count) const
+{
+	if (urgent_unsubmitted || prepared_count >= batching_policy.min_batch_size || isPolled())
+		return true;
+	return Clock::now() - oldest_unsubmitted >= batching_policy.max_delay;
+}
+
+std::optional<std::chrono::nanoseconds> SubmissionQueue::batchDelayLeft() const
+{
+	if (batching_policy.min_batch_size <= 1 || io_uring_sq_ready(&ring) == 0)
+		return std::nullopt;
+	const std::chrono::nanoseconds waited = Clock::now() - oldest_unsubmitted;
+	return std::max(std::chrono::nanoseconds{ 0 }, batching_policy.max_delay - waited);
+}
+
+void SubmissionQueue::onSubmission()
+{
+	++submissions_count;
+	submitted_entries_count += io_uring_sq_ready(&ring);
+	urgent_unsubmitted = false;
+}
+
+bool SubmissionQueue::hasCompletions() const
+{
+	return io_uring_cq_ready(&ring) > 0;
+}
+
+bool SubmissionQueue::pollCompletions()
+{
+	flushTaskWork();
+	return hasCompletions();
+}
+
+void SubmissionQueue::flushTaskWork()
+{
+	if (hasCompletions())
+		return;
+
+	// Deferred or cooperative task work is flagged by the kernel (IORING_SETUP_TASKRUN_FLAG), as are overflowed
+	// completions: only enter the kernel if there is something to post.
+	const unsigned flags = IO_URING_READ_ONCE(*ring.sq.kflags);
+	if (flags & (IORING_SQ_TASKRUN | IORING_SQ_CQ_OVERFLOW))
+		io_uring_get_events(&ring);
+}
+
+bool SubmissionQueue::flushOverflowedCompletions()
+{
+	if (!(IO_URING_READ_ONCE(*ring.sq.kflags) & IORING_SQ_CQ_OVERFLOW))
+		return false;
+	io_uring_get_events(&ring);
+	return true;
+}
+
+bool SubmissionQueue::isPolled() const
+{
+	return ring.flags & IORING_SETUP_SQPOLL;
 }
 
 io_uring &SubmissionQueue::getRing()
@@ -57,14 +319,68 @@ io_uring &SubmissionQueue::getRing()
 
 size_t SubmissionQueue::preparePendingRequests()
 {
-	std::lock_guard<std::mutex> lock_guard(pending_requests_mutex);
-	size_t pending_requests_count = 0;
-	pending_requests.for_each([this, &pending_requests_count](const auto &request) {
-		++pending_requests_count;
-		prepare(request);
-	});
-	pending_requests.clear();
-	return pending_requests_count;
+	// Batches only need the age of their oldest request.
+	const bool track_age = batching_policy.min_batch_size > 1 && io_uring_sq_ready(&ring) == 0;
+
+	size_t prepared_requests_count = 0;
+	SlotLink *link = unprepared_request ? std::exchange(unprepared_request, nullptr) : pending_requests.pop();
+	while (link) {
+		if (prepare(headerOf(link)) == QUEUE_FULL) {
+			// Even after submitting: the kernel is not consuming entries (e.g. busy flushing overflowed
+			// completions). Retried on next submission, preserving the order.
+			unprepared_request = link;
+			break;
+		}
+		++prepared_requests_count;
+		link = pending_requests.pop();
+	}
+
+	if (track_age && prepared_requests_count > 0)
+		oldest_unsubmitted = Clock::now();
+	return prepared_requests_count;
+}
+
+AddRequestStatus SubmissionQueue::prepare(RequestHeader *header)
+{
+	if (header->has(URGENT))
+		urgent_unsubmitted = true;
+
+	switch (header->op) {
+	case Operation::ACCEPT:
+		return prepare(reinterpret_cast<AcceptRequest *>(header));
+	case Operation::CONNECT:
+		return prepare(reinterpret_cast<ConnectRequest *>(header));
+	case Operation::READ:
+		return prepare(reinterpret_cast<ReadRequest *>(header));
+	case Operation::READ_MULTISHOT:
+		return prepare(reinterpret_cast<MultiShotReadRequest *>(header));
+	case Operation::READ_BUNDLE:
+		return prepare(reinterpret_cast<BundleReadRequest *>(header));
+	case Operation::READ_PROVIDED_BUFFER:
+		return prepare(reinterpret_cast<ProvidedBufferReadRequest *>(header));
+	case Operation::WRITE:
+		return prepare(reinterpret_cast<WriteRequest *>(header));
+	case Operation::WRITE_FIXED:
+		return prepare(reinterpret_cast<WriteFixedRequest *>(header));
+	case Operation::WRITEV:
+		return prepare(reinterpret_cast<WritevRequest *>(header));
+	case Operation::SEND_ZERO_COPY:
+		return prepare(reinterpret_cast<SendZeroCopyRequest *>(header));
+	case Operation::MESSAGE:
+		return prepare(reinterpret_cast<MessageRequest *>(header));
+	case Operation::TIMEOUT:
+		return prepare(reinterpret_cast<TimeoutRequest *>(header));
+	case Operation::TIMEOUT_UPDATE:
+		return prepare(reinterpret_cast<TimeoutUpdateRequest *>(header));
+	case Operation::CANCEL:
+		return prepare(reinterpret_cast<CancelRequest *>(header));
+	case Operation::CLOSE:
+		return prepare(reinterpret_cast<CloseRequest *>(header));
+	case Operation::WAKEUP:
+	case Operation::LINK_TIMEOUT:
+		break;
+	}
+	return OK;
 }
 
 AddRequestStatus SubmissionQueue::prepare(AcceptRequest *request)
@@ -74,32 +390,88 @@ AddRequestStatus SubmissionQueue::prepare(AcceptRequest *request)
 	if (!sqe)
 		return QUEUE_FULL;
 
-	io_uring_prep_multishot_accept(sqe, request->listening_socket_fd, nullptr, nullptr, 0);
-	io_uring_sqe_set_data(sqe, (void *)(request));
+	if (request->direct)
+		io_uring_prep_multishot_accept_direct(sqe, request->listening_socket_fd, nullptr, nullptr, 0);
+	else
+		io_uring_prep_multishot_accept(sqe, request->listening_socket_fd, nullptr, nullptr, 0);
+	setFileFlags(sqe, request->header);
+	io_uring_sqe_set_data64(sqe, UserData::of(request->header).value);
+	active_multishots.emplace(fileKey(request->listening_socket_fd, request->header), &request->header);
 	return OK;
 }
 
 AddRequestStatus SubmissionQueue::prepare(ConnectRequest *request)
 {
-	io_uring_sqe *sqe = getNewSubmissionQueueEntry();
-
-	if (!sqe)
+	if (!reserveSubmissionQueueEntries(entriesCount(request->timeout)))
 		return QUEUE_FULL;
 
+	io_uring_sqe *sqe = getNewSubmissionQueueEntry();
 	io_uring_prep_connect(sqe, request->socket_fd, request->addr, request->addrlen);
-	io_uring_sqe_set_data(sqe, (void *)(request));
+	setFileFlags(sqe, request->header);
+	io_uring_sqe_set_data64(sqe, UserData::of(request->header).value);
+	linkTimeout(sqe, request->header, request->timeout);
+	trackSubscribed(request->socket_fd, request->header);
 	return OK;
 }
 
 AddRequestStatus SubmissionQueue::prepare(WriteRequest *request)
+{
+	if (!reserveSubmissionQueueEntries(entriesCount(request->timeout)))
+		return QUEUE_FULL;
+
+	io_uring_sqe *sqe = getNewSubmissionQueueEntry();
+	io_uring_prep_write(sqe, request->fd, request->bytes_written.data(), request->bytes_written.size(), 0);
+	setFileFlags(sqe, request->header);
+	io_uring_sqe_set_data64(sqe, UserData::of(request->header).value);
+	linkTimeout(sqe, request->header, request->timeout);
+	trackSubscribed(request->fd, request->header);
+	return OK;
+}
+
+AddRequestStatus SubmissionQueue::prepare(WriteFixedRequest *request)
+{
+	if (!reserveSubmissionQueueEntries(entriesCount(request->timeout)))
+		return QUEUE_FULL;
+
+	io_uring_sqe *sqe = getNewSubmissionQueueEntry();
+	io_uring_prep_write_fixed(sqe, request->fd, request->bytes_written.data(), request->bytes_written.size(), 0,
+				  request->buffer_index);
+	setFileFlags(sqe, request->header);
+	io_uring_sqe_set_data64(sqe, UserData::of(request->header).value);
+	linkTimeout(sqe, request->header, request->timeout);
+	trackSubscribed(request->fd, request->header);
+	return OK;
+}
+
+AddRequestStatus SubmissionQueue::prepare(WritevRequest *request)
+{
+	if (!reserveSubmissionQueueEntries(entriesCount(request->timeout)))
+		return QUEUE_FULL;
+
+	request->message = msghdr{};
+	request->message.msg_iov = const_cast<iovec *>(request->buffers.data());
+	request->message.msg_iovlen = request->buffers.size();
+
+	io_uring_sqe *sqe = getNewSubmissionQueueEntry();
+	io_uring_prep_sendmsg(sqe, request->fd, &request->message, static_cast<unsigned>(request->message_flags));
+	setFileFlags(sqe, request->header);
+	io_uring_sqe_set_data64(sqe, UserData::of(request->header).value);
+	linkTimeout(sqe, request->header, request->timeout);
+	trackSubscribed(request->fd, request->header);
+	return OK;
+}
+
+AddRequestStatus SubmissionQueue::prepare(SendZeroCopyRequest *request)
 {
 	io_uring_sqe *sqe = getNewSubmissionQueueEntry();
 
 	if (!sqe)
 		return QUEUE_FULL;
 
-	io_uring_prep_write(sqe, request->fd, request->bytes_written.data(), request->bytes_written.size(), 0);
-	io_uring_sqe_set_data(sqe, (void *)(request));
+	io_uring_prep_send_zc(sqe, request->fd, request->bytes_sent.data(), request->bytes_sent.size(), 0, 0);
+	setFileFlags(sqe, request->header);
+	io_uring_sqe_set_data64(sqe, UserData::of(request->header).value);
+	trackSubscribed(request->fd, request->header);
 	return OK;
 }
 
@@ -111,7 +483,9 @@ AddRequestStatus SubmissionQueue::prepare(ReadRequest *request)
 		return QUEUE_FULL;
 
 	io_uring_prep_read(sqe, request->fd, request->reception_buffer.data(), request->reception_buffer.size(), 0);
-	io_uring_sqe_set_data(sqe, (void *)(request));
+	setFileFlags(sqe, request->header);
+	io_uring_sqe_set_data64(sqe, UserData::of(request->header).value);
+	trackSubscribed(request->fd, request->header);
 	return OK;
 }
 
@@ -126,44 +500,361 @@ AddRequestStatus SubmissionQueue::prepare(MultiShotReadRequest *request)
 	sqe->buf_group = request->buffer_group_id;
 
 	io_uring_prep_read_multishot(sqe, request->fd, 0, 0, request->buffer_group_id);
-	io_uring_sqe_set_data(sqe, (void *)(request));
+	setFileFlags(sqe, request->header);
+	io_uring_sqe_set_data64(sqe, UserData::of(request->header).value);
+	active_multishots.emplace(fileKey(request->fd, request->header), &request->header);
 	return OK;
 }
 
-io_uring_sqe *SubmissionQueue::getNewSubmissionQueueEntry()
+AddRequestStatus SubmissionQueue::prepare(BundleReadRequest *request)
 {
-	io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+	io_uring_sqe *sqe = getNewSubmissionQueueEntry();
 
-	if (!sqe) {
-		io_uring_submit(&ring);
-		sqe = io_uring_get_sqe(&ring);
+	if (!sqe)
+		return QUEUE_FULL;
+
+	// A null length receives up to the size of the selected buffers.
+	io_uring_prep_recv_multishot(sqe, request->fd, nullptr, 0, 0);
+	sqe->ioprio |= IORING_RECVSEND_BUNDLE;
+	sqe->flags |= IOSQE_BUFFER_SELECT;
+	sqe->buf_group = request->buffer_group_id;
+	setFileFlags(sqe, request->header);
+	io_uring_sqe_set_data64(sqe, UserData::of(request->header).value);
+	active_multishots.emplace(fileKey(request->fd, request->header), &request->header);
+	return OK;
+}
+
+AddRequestStatus SubmissionQueue::prepare(ProvidedBufferReadRequest *request)
+{
+	if (!reserveSubmissionQueueEntries(entriesCount(request->timeout)))
+		return QUEUE_FULL;
+
+	io_uring_sqe *sqe = getNewSubmissionQueueEntry();
+	// A null length reads up to the size of the selected buffer.
+	io_uring_prep_read(sqe, request->fd, nullptr, 0, 0);
+	setFileFlags(sqe, request->header);
+	sqe->flags |= IOSQE_BUFFER_SELECT;
+	sqe->buf_group = request->buffer_group_id;
+	io_uring_sqe_set_data64(sqe, UserData::of(request->header).value);
+	linkTimeout(sqe, request->header, request->timeout);
+	trackSubscribed(request->fd, request->header);
+	return OK;
+}
+
+AddRequestStatus SubmissionQueue::prepare(MessageRequest *request)
+{
+	io_uring_sqe *sqe = getNewSubmissionQueueEntry();
+
+	if (!sqe)
+		return QUEUE_FULL;
+
+	io_uring_prep_msg_ring(sqe, request->target_ring_fd, 0, request->data, 0);
+	io_uring_sqe_set_data64(sqe, UserData::of(request->header).value);
+	return OK;
+}
+
+AddRequestStatus SubmissionQueue::prepare(TimeoutRequest *request)
+{
+	io_uring_sqe *sqe = getNewSubmissionQueueEntry();
+
+	if (!sqe)
+		return QUEUE_FULL;
+
+	static constexpr unsigned NO_COMPLETION_COUNT = 0;
+	io_uring_prep_timeout(sqe, &request->deadline, NO_COMPLETION_COUNT, IORING_TIMEOUT_ABS);
+	io_uring_sqe_set_data64(sqe, UserData::of(request->header).value);
+	return OK;
+}
+
+AddRequestStatus SubmissionQueue::prepare(TimeoutUpdateRequest *request)
+{
+	io_uring_sqe *sqe = getNewSubmissionQueueEntry();
+
+	if (!sqe)
+		return QUEUE_FULL;
+
+	// The timeout is identified by its user data.
+	io_uring_prep_timeout_update(sqe, &request->deadline, UserData::of(request->timeout->header).value,
+				     IORING_TIMEOUT_ABS);
+	io_uring_sqe_set_data64(sqe, UserData::of(request->header).value);
+	return OK;
+}
+
+AddRequestStatus SubmissionQueue::prepare(CancelRequest *request)
+{
+	io_uring_sqe *sqe = getNewSubmissionQueueEntry();
+
+	if (!sqe)
+		return QUEUE_FULL;
+
+	if (request->rearmed) {
+		RequestHeader *rearmed = request->rearmed;
+		if (!isArmed(request->fd, *rearmed) || rearmed->has(REARM) || !rearmed->user_data) {
+			// Terminated, thus armed again in its next buffer group if at all, or already being cancelled.
+			io_uring_prep_nop(sqe);
+		} else {
+			// Targeted by the user data it was submitted with, before flagging it.
+			io_uring_prep_cancel64(sqe, UserData::of(*rearmed).value, 0);
+			rearmed->flags |= REARM;
+		}
+		io_uring_sqe_set_data64(sqe, UserData::of(request->header).value);
+		return OK;
 	}
-	return sqe;
+
+	unsigned flags = IORING_ASYNC_CANCEL_ALL | IORING_ASYNC_CANCEL_FD;
+	if (request->header.has(FIXED_FILE))
+		flags |= IORING_ASYNC_CANCEL_FD_FIXED;
+	io_uring_prep_cancel_fd(sqe, request->fd, flags);
+	io_uring_sqe_set_data64(sqe, UserData::of(request->header).value);
+
+	// Issued since the cancellation was queued: pushed before it.
+	if (request->detach)
+		detachRequests(request->fd, request->header);
+	return OK;
 }
 
-void SubmissionQueue::release(io_uring_cqe *cqe)
+AddRequestStatus SubmissionQueue::prepare(CloseRequest *request)
 {
-	const uring::RequestHeader *header = reinterpret_cast<const RequestHeader *>(cqe->user_data);
-	if (!header->valid())
+	io_uring_sqe *sqe = getNewSubmissionQueueEntry();
+
+	if (!sqe)
+		return QUEUE_FULL;
+
+	if (request->header.has(FIXED_FILE))
+		io_uring_prep_close_direct(sqe, request->fd);
+	else
+		io_uring_prep_close(sqe, request->fd);
+	io_uring_sqe_set_data64(sqe, UserData::of(request->header).value);
+	return OK;
+}
+
+void SubmissionQueue::setFileFlags(io_uring_sqe *sqe, const RequestHeader &header)
+{
+	if (header.has(FIXED_FILE))
+		sqe->flags |= IOSQE_FIXED_FILE;
+}
+
+uint64_t SubmissionQueue::fileKey(int fd, const RequestHeader &header)
+{
+	const uint64_t fixed = header.has(FIXED_FILE) ? 1 : 0;
+	return (fixed << 32) | static_cast<uint32_t>(fd);
+}
+
+template <class Request>
+int SubmissionQueue::fileOf(const Request &request)
+{
+	if constexpr (std::is_same_v<Request, AcceptRequest>)
+		return request.listening_socket_fd;
+	else if constexpr (std::is_same_v<Request, ConnectRequest>)
+		return request.socket_fd;
+	else
+		return request.fd;
+}
+
+io_uring_sqe *SubmissionQueue::getNewSubmissionQueueEntry()
+{
+	if (!reserveSubmissionQueueEntries(1))
+		return nullptr;
+	return io_uring_get_sqe(&ring);
+}
+
+bool SubmissionQueue::reserveSubmissionQueueEntries(unsigned count)
+{
+	if (io_uring_sq_space_left(&ring) >= count)
+		return true;
+
+	onSubmission();
+	io_uring_submit(&ring);
+	// The polling thread consumes entries asynchronously: wait for it to make room.
+	if (isPolled())
+		io_uring_sqring_wait(&ring);
+	return io_uring_sq_space_left(&ring) >= count;
+}
+
+unsigned SubmissionQueue::entriesCount(const LinkedTimeout &timeout)
+{
+	return timeout.enabled ? 2 : 1;
+}
+
+void SubmissionQueue::linkTimeout(io_uring_sqe *sqe, const RequestHeader &header, LinkedTimeout &timeout)
+{
+	if (!timeout.enabled)
 		return;
 
-	switch (header->op) {
-		// Do not release multi-shot requests
+	sqe->flags |= IOSQE_IO_LINK;
+	io_uring_sqe *timeout_sqe = io_uring_get_sqe(&ring);
+	io_uring_prep_link_timeout(timeout_sqe, &timeout.duration, 0);
+	// Tagged with the request: its completion tells whether the deadline expired, which the request cannot.
+	io_uring_sqe_set_data64(timeout_sqe, UserData::of(Operation::LINK_TIMEOUT, header).value);
+}
+
+void SubmissionQueue::release(io_uring_cqe *cqe)
+{
+	const UserData user_data{ cqe->user_data };
+	assert(!user_data.header() || user_data.header()->valid());
+
+	switch (user_data.op()) {
 	case Operation::ACCEPT:
+		releaseMultishot(cqe, user_data.request<AcceptRequest>());
+		return;
 	case Operation::READ_MULTISHOT:
+		releaseMultishot(cqe, user_data.request<MultiShotReadRequest>());
+		return;
+	case Operation::READ_BUNDLE:
+		releaseMultishot(cqe, user_data.request<BundleReadRequest>());
+		return;
+		// Not a pooled request: owned by the receiving event loop
+	case Operation::WAKEUP:
+		return;
+	case Operation::LINK_TIMEOUT:
+		releaseLinkedTimeout(user_data.header());
 		return;
 	case Operation::READ:
-		request_pool.deallocate(reinterpret_cast<ReadRequest *>(cqe->user_data));
+		releaseSubscribed(user_data.request<ReadRequest>());
+		return;
+	case Operation::READ_PROVIDED_BUFFER:
+		releaseLinked(user_data.request<ProvidedBufferReadRequest>());
 		return;
 	case Operation::WRITE:
-		request_pool.deallocate(reinterpret_cast<WriteRequest *>(cqe->user_data));
+		releaseLinked(user_data.request<WriteRequest>());
+		return;
+	case Operation::WRITEV:
+		releaseLinked(user_data.request<WritevRequest>());
+		return;
+	case Operation::SEND_ZERO_COPY:
+		// The result of the send is followed by a notification: the bytes are still in use until then.
+		if (cqe->flags & IORING_CQE_F_MORE)
+			return;
+		releaseSubscribed(user_data.request<SendZeroCopyRequest>());
+		return;
+	case Operation::WRITE_FIXED:
+		releaseLinked(user_data.request<WriteFixedRequest>());
+		return;
+	case Operation::CONNECT:
+		releaseLinked(user_data.request<ConnectRequest>());
+		return;
+	case Operation::MESSAGE:
+		request_pool.deallocate(user_data.request<MessageRequest>());
+		return;
+	case Operation::TIMEOUT:
+		request_pool.deallocate(user_data.request<TimeoutRequest>());
+		return;
+	case Operation::TIMEOUT_UPDATE:
+		request_pool.deallocate(user_data.request<TimeoutUpdateRequest>());
+		return;
+	case Operation::CANCEL:
+		request_pool.deallocate(user_data.request<CancelRequest>());
+		return;
+	case Operation::CLOSE:
+		request_pool.deallocate(user_data.request<CloseRequest>());
+		return;
+	}
+}
+
+size_t SubmissionQueue::requestPoolCapacity(size_t queue_size, const RingConfig &config)
+{
+	if (config.completion_queue_size.has_value())
+		return std::bit_ceil(size_t{ config.completion_queue_size.value() });
+	return 2 * std::bit_ceil(queue_size);
+}
+
+template <class Request>
+void SubmissionQueue::releaseLinked(Request *request)
+{
+	if (request->timeout.enabled && ++request->timeout.completions < 2)
 		return;
+
+	if constexpr (std::is_same_v<Request, WriteFixedRequest>)
+		send_buffers.release(request->buffer_index);
+	releaseSubscribed(request);
+}
+
+template <class Request>
+void SubmissionQueue::releaseSubscribed(Request *request)
+{
+	if (!request->header.has(NOTIFY_SINK)) {
+		auto [first, last] = subscribed_requests.equal_range(fileKey(fileOf(*request), request->header));
+		for (auto it = first; it != last; ++it) {
+			if (it->second == &request->header) {
+				subscribed_requests.erase(it);
+				break;
+			}
+		}
+	}
+	request_pool.deallocate(request);
+}
+
+void SubmissionQueue::releaseLinkedTimeout(RequestHeader *header)
+{
+	switch (header->op) {
 	case Operation::CONNECT:
-		request_pool.deallocate(reinterpret_cast<ConnectRequest *>(cqe->user_data));
+		releaseLinked(reinterpret_cast<ConnectRequest *>(header));
+		return;
+	case Operation::READ_PROVIDED_BUFFER:
+		releaseLinked(reinterpret_cast<ProvidedBufferReadRequest *>(header));
+		return;
+	case Operation::WRITE:
+		releaseLinked(reinterpret_cast<WriteRequest *>(header));
+		return;
+	case Operation::WRITE_FIXED:
+		releaseLinked(reinterpret_cast<WriteFixedRequest *>(header));
+		return;
+	case Operation::WRITEV:
+		releaseLinked(reinterpret_cast<WritevRequest *>(header));
+		return;
+	default:
+		assert(false && "Linked timeout of a request without deadline");
 		return;
 	}
 }
 
+template <class Request>
+void SubmissionQueue::releaseMultishot(io_uring_cqe *cqe, Request *request)
+{
+	if (cqe->flags & IORING_CQE_F_MORE)
+		return;
+
+	auto [first, last] = active_multishots.equal_range(fileKey(fileOf(*request), request->header));
+	for (auto it = first; it != last; ++it) {
+		if (it->second == &request->header) {
+			active_multishots.erase(it);
+			break;
+		}
+	}
+
+	// Moved to another buffer group (reads only): applied whenever armed again, cancelled for it or not.
+	bool rearm = false;
+	if constexpr (!std::is_same_v<Request, AcceptRequest>) {
+		if (request->next_buffer_group_id != NO_BUFFER_GROUP)
+			request->buffer_group_id = request->next_buffer_group_id;
+		if (request->header.has(REARM)) {
+			request->header.flags &= ~REARM;
+			rearm = cqe->res == -ECANCELED;
+		}
+	}
+
+	// Detached requests are not armed again: nobody would be notified.
+	if (request->header.user_data && (rearm || isTransientTermination(cqe, request->header.op)))
+		pending_requests.push(&RequestSlot<Request>::from(request)->link);
+	else
+		request_pool.deallocate(request);
+}
+
+bool SubmissionQueue::isTransientTermination(const io_uring_cqe *cqe, Operation op)
+{
+	if (cqe->res == -ENOBUFS)
+		return true;
+	// A multi-shot read ends with the connection, on end of file.
+	if (op == Operation::READ_MULTISHOT || op == Operation::READ_BUNDLE)
+		return cqe->res > 0;
+	return cqe->res >= 0;
+}
+
+size_t SubmissionQueue::activeMultishotsCount() const
+{
+	return active_multishots.size();
+}
+
 void SubmissionQueue::throwOnError(int liburing_error, std::string_view message)
 {
 	if (liburing_error < 0)